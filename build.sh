@@ -5,6 +5,14 @@ console=0
 install=0
 debug=0
 norun=0
+switch=0
+jit=0
+decode=0
+profile=0
+regs=0
+tos=0
+bench=0
+cores=
 
 while [ $# -gt 0 ]; do
 	case $1 in
@@ -33,6 +41,51 @@ while [ $# -gt 0 ]; do
 			shift
 			;;
 
+		--switch)
+			switch=1
+			shift
+			;;
+
+		--jit)
+			jit=1
+			shift
+			;;
+
+		--decode)
+			decode=1
+			shift
+			;;
+
+		--profile)
+			profile=1
+			shift
+			;;
+
+		--regs)
+			regs=1
+			shift
+			;;
+
+		--tos)
+			tos=1
+			shift
+			;;
+
+		--bench)
+			bench=1
+			shift
+			;;
+
+		--cores)
+			cores=all
+			shift
+			;;
+
+		--cores=*)
+			cores="${1#--cores=}"
+			shift
+			;;
+
 		*)
 			shift
 	esac
@@ -47,6 +100,7 @@ then
 	clang-format -i src/uxnasm.c
 	clang-format -i src/uxncli.c
 	clang-format -i src/uxnemu.c
+	clang-format -i src/uxnheadless.c
 	clang-format -i src/devices/*
 fi
 
@@ -79,16 +133,130 @@ then
 else
 	CFLAGS="${CFLAGS} -DNDEBUG -O2 -g0 -s"
 fi
+BASE_CFLAGS="${CFLAGS}"
+
+if [ $switch = 1 ];
+then
+	echo "[switch]"
+	CFLAGS="${CFLAGS} -DUXN_SWITCH"
+fi
+
+CORE="src/uxn.c"
+if [ $jit = 1 ];
+then
+	echo "[jit]"
+	CFLAGS="${CFLAGS} -DUXN_JIT"
+	CORE="${CORE} src/jit.c"
+fi
+
+if [ $decode = 1 ];
+then
+	echo "[decode]"
+	CFLAGS="${CFLAGS} -DUXN_DECODE"
+fi
+
+if [ $regs = 1 ];
+then
+	echo "[regs]"
+	CFLAGS="${CFLAGS} -DUXN_REGS"
+fi
+
+if [ $tos = 1 ];
+then
+	echo "[tos]"
+	CFLAGS="${CFLAGS} -DUXN_TOS"
+fi
+
+if [ $profile = 1 ];
+then
+	echo "[profile]"
+	CFLAGS="${CFLAGS} -DUXN_PROFILE"
+	CORE="${CORE} src/profile.c"
+fi
+
+# With --cores, each core is compiled on its own and linked in beside the
+# others, uxncli and uxnemu pick one with -x, the first listed by default
+
+ALL_CORES="uxn,switch,decode,regs,tos,jit,abc,abc_disp,tnl"
+cores_build () {
+	list=""
+	objs=""
+	for name in $(echo $1 | tr ',' ' ')
+	do
+		case ${name} in
+			uxn) src="src/uxn.c" flags="" ;;
+			switch) src="src/uxn.c" flags="-DUXN_SWITCH" ;;
+			decode) src="src/uxn.c" flags="-DUXN_DECODE" ;;
+			regs) src="src/uxn.c" flags="-DUXN_REGS" ;;
+			tos) src="src/uxn.c" flags="-DUXN_TOS" ;;
+			jit) src="src/uxn.c src/jit.c" flags="-DUXN_JIT" ;;
+			abc) src="etc/cores/uxn-abc.c" flags="" ;;
+			abc_disp) src="etc/cores/uxn-abc-disp.c" flags="" ;;
+			tnl) src="etc/cores/uxn-tnl.c" flags="" ;;
+			*) echo "Unknown core ${name}"; exit 1 ;;
+		esac
+		for f in ${src}
+		do
+			obj=bin/core-${name}-$(basename ${f} .c).o
+			${CC} ${BASE_CFLAGS} ${flags} -Isrc -DUXN_CORE=${name} -c ${f} -o ${obj}
+			objs="${objs} ${obj}"
+		done
+		list="${list}X(${name})"
+	done
+	CORE="src/cores.c${objs}"
+	CORES_CFLAGS="-DUXN_CORES=${list}"
+}
+
+if [ -n "${cores}" ];
+then
+	echo "[cores]"
+	if [ "${cores}" = all ]; then cores="${ALL_CORES}"; fi
+	cores_build ${cores}
+	CFLAGS="${BASE_CFLAGS} ${CORES_CFLAGS}"
+fi
+
+# Benchmark every core on the cpu-bound roms, as JSON in bin/bench.json
+
+if [ $bench = 1 ]
+then
+	echo "[bench]"
+	BENCH_DEVICES="src/devices/system.c src/devices/console.c src/devices/datetime.c src/uxnbench.c"
+	BENCH_ROMS="projects/examples/exercises/fib.tal projects/examples/exercises/tak.tal projects/examples/exercises/primes.tal projects/examples/exercises/sierpinski.tal projects/examples/demos/mandelbrot.tal"
+	${CC} ${BASE_CFLAGS} src/uxnasm.c -o bin/uxnasm
+	${CC} ${BASE_CFLAGS} -DUXN_PROFILE src/uxn.c src/profile.c ${BENCH_DEVICES} -o bin/uxnbench-count
+	cores_build ${ALL_CORES}
+	${CC} ${BASE_CFLAGS} ${CORES_CFLAGS} ${CORE} ${BENCH_DEVICES} -o bin/uxnbench
+	sep="["
+	for tal in ${BENCH_ROMS}
+	do
+		rom=bin/bench-$(basename ${tal} .tal).rom
+		bin/uxnasm ${tal} ${rom} >/dev/null
+		ins=$(bin/uxnbench-count ${rom})
+		for core in $(echo ${ALL_CORES} | tr ',' ' ')
+		do
+			printf '%s\n\t%s' "${sep}" "$(bin/uxnbench -r ${BENCH_RUNS:-5} -i ${ins} -x ${core} ${rom})"
+			sep=","
+		done
+	done > bin/bench.json
+	printf '\n]\n' >> bin/bench.json
+	cat bin/bench.json
+	${CC} ${BASE_CFLAGS} src/devices/screen.c src/spritebench.c -o bin/spritebench
+	bin/spritebench > bin/sprites.json
+	exit
+fi
+
 set -x
 ${CC} ${CFLAGS} src/uxnasm.c -o bin/uxnasm
-${CC} ${CFLAGS} src/uxn.c src/devices/system.c src/devices/console.c src/devices/file.c src/devices/datetime.c src/devices/mouse.c src/devices/controller.c src/devices/screen.c src/devices/audio.c src/uxnemu.c ${UXNEMU_LDFLAGS} ${FILE_LDFLAGS} -o bin/uxnemu
-${CC} ${CFLAGS} src/uxn.c src/devices/system.c src/devices/console.c src/devices/file.c src/devices/datetime.c src/uxncli.c ${FILE_LDFLAGS} -o bin/uxncli
+${CC} ${CFLAGS} src/uxn2c.c -o bin/uxn2c
+${CC} ${CFLAGS} ${CORE} src/devices/system.c src/devices/console.c src/devices/file.c src/devices/datetime.c src/devices/mouse.c src/devices/controller.c src/devices/screen.c src/devices/audio.c src/uxnemu.c ${UXNEMU_LDFLAGS} ${FILE_LDFLAGS} -o bin/uxnemu
+${CC} ${CFLAGS} ${CORE} src/devices/system.c src/devices/console.c src/devices/file.c src/devices/datetime.c src/uxncli.c ${FILE_LDFLAGS} -lpthread -o bin/uxncli
+${CC} ${CFLAGS} ${CORE} src/devices/system.c src/devices/console.c src/devices/file.c src/devices/datetime.c src/devices/mouse.c src/devices/controller.c src/devices/screen.c src/devices/audio.c src/uxnheadless.c ${FILE_LDFLAGS} -o bin/uxnheadless
 set +x
 
 
 if [ $install = 1 ]
 then
-	cp bin/uxnemu bin/uxnasm bin/uxncli $HOME/bin/
+	cp bin/uxnemu bin/uxnasm bin/uxncli bin/uxnheadless $HOME/bin/
 fi
 
 if [ $norun = 1 ]; then exit; fi
@@ -97,6 +265,7 @@ if [ $norun = 1 ]; then exit; fi
 
 bin/uxnasm -v
 bin/uxncli -v
+bin/uxnheadless -v
 bin/uxnemu -v
 
 # Start potato
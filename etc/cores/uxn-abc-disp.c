@@ -14,16 +14,18 @@ WITH REGARD TO THIS SOFTWARE.
 #define FLIP     { s = ins & 0x40 ? &u->wst : &u->rst; }
 #define JUMP(x)  { if(m2) pc = (x); else pc += (Sint8)(x); }
 #define POP1(o)  { o = s->dat[--*sp]; }
-#define POP2(o)  { o = s->dat[--*sp] | (s->dat[--*sp] << 0x8); }
+#define POP2(o)  { o = s->dat[--*sp]; o |= s->dat[--*sp] << 0x8; }
 #define POPx(o)  { if(m2) { POP2(o) } else POP1(o) }
 #define PUSH1(y) { s->dat[s->ptr++] = (y); }
 #define PUSH2(y) { tt = (y); s->dat[s->ptr++] = tt >> 0x8; s->dat[s->ptr++] = tt; }
 #define PUSHx(y) { if(m2) { PUSH2(y) } else PUSH1(y) }
-#define PEEK(o, x, r) { if(m2) { r = (x); o = ram[r++] << 8 | ram[r]; } else o = ram[(x)]; }
-#define POKE(x, y, r) { if(m2) { r = (x); ram[r++] = y >> 8; ram[r] = y; } else ram[(x)] = (y); }
+#define PEEK(o, x, r) { if(m2) { r = (x); o = ram[r++] << 8; o |= ram[r]; } else o = ram[(x)]; }
+#define POKE(x, y, r) { r = (x); TOUCH(r) if(m2) { ram[r++] = y >> 8; ram[r] = y; } else ram[r] = (y); }
+#define TOUCH(i) { u->dirty[(Uint16)(i) >> 8] = u->dirty[(Uint16)((i) + 1) >> 8] = 1; }
 #define DEVR(o, p)    { if(m2) { o = (emu_dei(u, p) << 8) | emu_dei(u, p + 1); } else o = emu_dei(u, p); }
 #define DEVW(p, y)    { if(m2) { emu_deo(u, p, y >> 8); emu_deo(u, p + 1, y); } else emu_deo(u, p, y); }
-#define next { ins = ram[pc++]; \
+#define next { if(!step--) goto suspend; \
+	ins = ram[pc++]; \
 	m2 = ins & 0x20; \
 	s = ins & 0x40 ? &u->rst : &u->wst; \
 	if(ins & 0x80) kp = s->ptr, sp = &kp; else sp = &s->ptr; \
@@ -34,20 +36,21 @@ uxn_eval(Uxn *u, Uint16 pc)
 {
 	Uint8 t, kp, *sp, ins, m2, *ram = u->ram;
 	Uint16 tt, a, b, c;
+	Uint32 step = u->budget ? u->budget : STEP_MAX;
 	Stack *s;
 	static void* lut[] = {
 		&&_imm, &&_inc, &&_pop, &&_nip, &&_swp, &&_rot, &&_dup, &&_ovr,
 		&&_equ, &&_neq, &&_gth, &&_lth, &&_jmp, &&_jcn, &&_jsr, &&_sth,
 		&&_ldz, &&_stz, &&_ldr, &&_str, &&_lda, &&_sta, &&_dei, &&_deo,
 		&&_add, &&_sub, &&_mul, &&_div, &&_and, &&_ora, &&_eor, &&_sft };
-	if(!pc || u->dev[0x0f]) return 0;
+	if(!pc || u->dev[0x0f] || u->suspended) return 0;
 	next
 	_imm: 
 		switch(ins) {
 			case 0x00: /* BRK */ return 1;
 			case 0x20: /* JCI */ POP1(b) if(!b) { pc += 2; break; }
-			case 0x40: /* JMI */ a = ram[pc++] << 8 | ram[pc++]; pc += a; break;
-			case 0x60: /* JSI */ PUSH2(pc + 2) a = ram[pc++] << 8 | ram[pc++]; pc += a; break;
+			case 0x40: /* JMI */ a = ram[pc] << 8 | ram[pc + 1]; pc += a + 2; break;
+			case 0x60: /* JSI */ PUSH2(pc + 2) a = ram[pc] << 8 | ram[pc + 1]; pc += a + 2; break;
 			case 0x80: case 0xc0: /* LIT  */ PUSH1(ram[pc++]) break;
 			case 0xa0: case 0xe0: /* LIT2 */ PUSH1(ram[pc++]) PUSH1(ram[pc++]) break;
 		} next
@@ -82,4 +85,11 @@ uxn_eval(Uxn *u, Uint16 pc)
 	_ora: POPx(a) POPx(b) PUSHx(b | a) next
 	_eor: POPx(a) POPx(b) PUSHx(b ^ a) next
 	_sft: POP1(a) POPx(b) PUSHx(b >> (a & 0xf) << (a >> 4)) next
-}
\ No newline at end of file
+suspend:
+	u->suspended = pc;
+	return 0;
+}
+
+#ifdef UXN_CORE
+UxnCore uxn_core = {UXN_NAME(UXN_CORE), uxn_eval, 0, 0};
+#endif
@@ -14,13 +14,14 @@ WITH REGARD TO THIS SOFTWARE.
 #define FLIP     { s = ins & 0x40 ? &u->wst : &u->rst; }
 #define JUMP(x)  { if(m2) pc = (x); else pc += (Sint8)(x); }
 #define POP1(o)  { o = s->dat[--*sp]; }
-#define POP2(o)  { o = s->dat[--*sp] | (s->dat[--*sp] << 0x8); }
+#define POP2(o)  { o = s->dat[--*sp]; o |= s->dat[--*sp] << 0x8; }
 #define POPx(o)  { if(m2) { POP2(o) } else POP1(o) }
 #define PUSH1(y) { s->dat[s->ptr++] = (y); }
 #define PUSH2(y) { tt = (y); s->dat[s->ptr++] = tt >> 0x8; s->dat[s->ptr++] = tt; }
 #define PUSHx(y) { if(m2) { PUSH2(y) } else PUSH1(y) }
-#define PEEK(o, x, r) { if(m2) { r = (x); o = ram[r++] << 8 | ram[r]; } else o = ram[(x)]; }
-#define POKE(x, y, r) { if(m2) { r = (x); ram[r++] = y >> 8; ram[r] = y; } else ram[(x)] = (y); }
+#define PEEK(o, x, r) { if(m2) { r = (x); o = ram[r++] << 8; o |= ram[r]; } else o = ram[(x)]; }
+#define POKE(x, y, r) { r = (x); TOUCH(r) if(m2) { ram[r++] = y >> 8; ram[r] = y; } else ram[r] = (y); }
+#define TOUCH(i) { u->dirty[(Uint16)(i) >> 8] = u->dirty[(Uint16)((i) + 1) >> 8] = 1; }
 #define DEVR(o, p)    { if(m2) { o = (emu_dei(u, p) << 8) | emu_dei(u, p + 1); } else o = emu_dei(u, p); }
 #define DEVW(p, y)    { if(m2) { emu_deo(u, p, y >> 8); emu_deo(u, p + 1, y); } else emu_deo(u, p, y); }
 
@@ -29,8 +30,9 @@ uxn_eval(Uxn *u, Uint16 pc)
 {
 	Uint8 t, kp, *sp, *ram = u->ram;
 	Uint16 tt, a, b, c;
-	if(!pc || u->dev[0x0f]) return 0;
-	for(;;) {
+	Uint32 step;
+	if(!pc || u->dev[0x0f] || u->suspended) return 0;
+	for(step = u->budget ? u->budget : STEP_MAX; step; step--) {
 		Uint8 ins = ram[pc++];
 		/* 2 */ Uint8 m2 = ins & 0x20;
 		/* r */ Stack *s = ins & 0x40 ? &u->rst : &u->wst;
@@ -40,8 +42,8 @@ uxn_eval(Uxn *u, Uint16 pc)
 		switch(ins) {
 			case 0x00: /* BRK */ return 1;
 			case 0x20: /* JCI */ POP1(b) if(!b) { pc += 2; break; }
-			case 0x40: /* JMI */ a = ram[pc++] << 8 | ram[pc++]; pc += a; break;
-			case 0x60: /* JSI */ PUSH2(pc + 2) a = ram[pc++] << 8 | ram[pc++]; pc += a; break;
+			case 0x40: /* JMI */ a = ram[pc] << 8 | ram[pc + 1]; pc += a + 2; break;
+			case 0x60: /* JSI */ PUSH2(pc + 2) a = ram[pc] << 8 | ram[pc + 1]; pc += a + 2; break;
 			case 0x80: case 0xc0: /* LIT  */ PUSH1(ram[pc++]) break;
 			case 0xa0: case 0xe0: /* LIT2 */ PUSH1(ram[pc++]) PUSH1(ram[pc++]) break;
 		} break;
@@ -78,4 +80,10 @@ uxn_eval(Uxn *u, Uint16 pc)
 		case 0x1f: /* SFT */ POP1(a) POPx(b) PUSHx(b >> (a & 0xf) << (a >> 4)) break;
 		}
 	}
+	u->suspended = pc;
+	return 0;
 }
+
+#ifdef UXN_CORE
+UxnCore uxn_core = {UXN_NAME(UXN_CORE), uxn_eval, 0, 0};
+#endif
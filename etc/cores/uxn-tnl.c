@@ -17,12 +17,14 @@ WITH REGARD TO THIS SOFTWARE.
 [   L2   ][   N2   ][   T2   ] <
 */
 
-#define T *(s->dat + s->ptr)
-#define N *(s->dat + (Uint8)(s->ptr - 1))
-#define L *(s->dat + (Uint8)(s->ptr - 2))
-#define X *(s->dat + (Uint8)(s->ptr - 3))
-#define Y *(s->dat + (Uint8)(s->ptr - 4))
-#define Z *(s->dat + (Uint8)(s->ptr - 5))
+/* The stack pointer counts the bytes held, T is the one below it. */
+
+#define T *(s->dat + (Uint8)(s->ptr - 1))
+#define N *(s->dat + (Uint8)(s->ptr - 2))
+#define L *(s->dat + (Uint8)(s->ptr - 3))
+#define X *(s->dat + (Uint8)(s->ptr - 4))
+#define Y *(s->dat + (Uint8)(s->ptr - 5))
+#define Z *(s->dat + (Uint8)(s->ptr - 6))
 #define T2 (N << 8 | T)
 #define H2 (L << 8 | N)
 #define N2 (X << 8 | L)
@@ -33,14 +35,16 @@ WITH REGARD TO THIS SOFTWARE.
 #define FLIP      { s = ins & 0x40 ? &u->wst : &u->rst; }
 #define SHIFT(y)  { s->ptr += (y); }
 #define SET(x, y) { SHIFT((ins & 0x80) ? x + y : y) }
+#define TOUCH(i)  { u->dirty[(Uint16)(i) >> 8] = u->dirty[(Uint16)((i) + 1) >> 8] = 1; }
 
 int
 uxn_eval(Uxn *u, Uint16 pc)
 {
 	Uint16 t, n, l, r;
 	Uint8 *ram = u->ram, *rr;
-	if(!pc || u->dev[0x0f]) return 0;
-	for(;;) {
+	Uint32 step;
+	if(!pc || u->dev[0x0f] || u->suspended) return 0;
+	for(step = u->budget ? u->budget : STEP_MAX; step; step--) {
 		Uint8 ins = ram[pc++];
 		Stack *s = ins & 0x40 ? &u->rst : &u->wst;
 		switch(ins & 0x3f) {
@@ -87,16 +91,16 @@ uxn_eval(Uxn *u, Uint16 pc)
 		case 0x2f: /* STH2 */ t=T2;           SET(2,-2) FLIP SHIFT(2) T2_(t) break;
 		case 0x10: /* LDZ  */ t=T;            SET(1, 0) T = ram[t]; break;
 		case 0x30: /* LDZ2 */ t=T;            SET(1, 1) N = ram[t++]; T = ram[(Uint8)t]; break;
-		case 0x11: /* STZ  */ t=T;n=N;        SET(2,-2) ram[t] = n; break;
-		case 0x31: /* STZ2 */ t=T;n=H2;       SET(3,-3) ram[t++] = n >> 8; ram[(Uint8)t] = n; break;
+		case 0x11: /* STZ  */ t=T;n=N;        SET(2,-2) TOUCH(t) ram[t] = n; break;
+		case 0x31: /* STZ2 */ t=T;n=H2;       SET(3,-3) TOUCH(t) ram[t++] = n >> 8; ram[(Uint8)t] = n; break;
 		case 0x12: /* LDR  */ t=T;            SET(1, 0) r = pc + (Sint8)t; T = ram[r]; break;
 		case 0x32: /* LDR2 */ t=T;            SET(1, 1) r = pc + (Sint8)t; N = ram[r++]; T = ram[r]; break;
-		case 0x13: /* STR  */ t=T;n=N;        SET(2,-2) r = pc + (Sint8)t; ram[r] = n; break;
-		case 0x33: /* STR2 */ t=T;n=H2;       SET(3,-3) r = pc + (Sint8)t; ram[r++] = n >> 8; ram[r] = n; break;
+		case 0x13: /* STR  */ t=T;n=N;        SET(2,-2) r = pc + (Sint8)t; TOUCH(r) ram[r] = n; break;
+		case 0x33: /* STR2 */ t=T;n=H2;       SET(3,-3) r = pc + (Sint8)t; TOUCH(r) ram[r++] = n >> 8; ram[r] = n; break;
 		case 0x14: /* LDA  */ t=T2;           SET(2,-1) T = ram[t]; break;
 		case 0x34: /* LDA2 */ t=T2;           SET(2, 0) N = ram[t++]; T = ram[t]; break;
-		case 0x15: /* STA  */ t=T2;n=L;       SET(3,-3) ram[t] = n; break;
-		case 0x35: /* STA2 */ t=T2;n=N2;      SET(4,-4) ram[t++] = n >> 8; ram[t] = n; break;
+		case 0x15: /* STA  */ t=T2;n=L;       SET(3,-3) TOUCH(t) ram[t] = n; break;
+		case 0x35: /* STA2 */ t=T2;n=N2;      SET(4,-4) TOUCH(t) ram[t++] = n >> 8; ram[t] = n; break;
 		case 0x16: /* DEI  */ t=T;            SET(1, 0) T = emu_dei(u, t); break;
 		case 0x36: /* DEI2 */ t=T;            SET(1, 1) N = emu_dei(u, t++); T = emu_dei(u, t); break;
 		case 0x17: /* DEO  */ t=T;n=N;        SET(2,-2) emu_deo(u, t, n); break;
@@ -119,5 +123,10 @@ uxn_eval(Uxn *u, Uint16 pc)
 		case 0x3f: /* SFT2 */ t=T;n=H2;       SET(3,-1) T2_(n >> (t & 0xf) << (t >> 4)) break;
 		}
 	}
+	u->suspended = pc;
+	return 0;
 }
 
+#ifdef UXN_CORE
+UxnCore uxn_core = {UXN_NAME(UXN_CORE), uxn_eval, 0, 0};
+#endif
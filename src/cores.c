@@ -0,0 +1,58 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "uxn.h"
+
+/*
+Copyright (c) 2025 Devine Lu Linvega, Andrew Alderwick
+
+Permission to use, copy, modify, and distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE.
+*/
+
+/* The cores linked in, as listed by UXN_CORES, the first one runs unless
+another is selected before the first machine is booted. */
+
+#define X(name) extern UxnCore uxn_core_##name;
+UXN_CORES
+#undef X
+
+#define X(name) &uxn_core_##name,
+static UxnCore *cores[] = {UXN_CORES NULL};
+#undef X
+
+static int selected;
+
+int
+uxn_select(char *name)
+{
+	int i;
+	for(i = 0; cores[i]; i++)
+		if(!strcmp(cores[i]->name, name)) {
+			selected = i;
+			return 1;
+		}
+	return 0;
+}
+
+int
+uxn_eval(Uxn *u, Uint16 pc)
+{
+	return cores[selected]->eval(u, pc);
+}
+
+void
+uxn_invalidate(Uxn *u, Uint16 addr, unsigned int len)
+{
+	if(cores[selected]->invalidate) cores[selected]->invalidate(u, addr, len);
+}
+
+void
+uxn_release(Uxn *u)
+{
+	if(cores[selected]->release) cores[selected]->release(u);
+}
@@ -72,7 +72,7 @@ audio_render(int instance, Sint16 *sample, Sint16 *end)
 }
 
 void
-audio_start(int instance, Uint8 *d)
+audio_start(int instance, Uint8 *d, Uint8 *ram)
 {
 	UxnAudio *c = &uxn_audio[instance];
 	Uint8 pitch = d[0xf] & 0x7f;
@@ -81,7 +81,7 @@ audio_start(int instance, Uint8 *d)
 	c->len = PEEK2(d + 0xa);
 	if(c->len > 0x10000 - addr)
 		c->len = 0x10000 - addr;
-	c->addr = &uxn.ram[addr];
+	c->addr = &ram[addr];
 	c->volume[0] = d[0xe] >> 4;
 	c->volume[1] = d[0xe] & 0xf;
 	c->repeat = !(d[0xf] & 0x80);
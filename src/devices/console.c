@@ -18,32 +18,32 @@ WITH REGARD TO THIS SOFTWARE.
 /* console registers */
 
 int
-console_input(int c, int type)
+console_input(Uxn *u, int c, int type)
 {
 	if(c == EOF) c = 0, type = 4;
-	uxn.dev[0x12] = c, uxn.dev[0x17] = type;
-	uxn_eval(console_vector);
+	u->dev[0x12] = c, u->dev[0x17] = type;
+	uxn_eval(u, u->console_vector);
 	return type != 4;
 }
 
 void
-console_arguments(int i, int argc, char **argv)
+console_arguments(Uxn *u, int i, int argc, char **argv)
 {
 	for(; i < argc; i++) {
 		char *p = argv[i];
 		while(*p)
-			console_input(*p++, CONSOLE_ARG);
-		console_input('\n', i == argc - 1 ? CONSOLE_END : CONSOLE_EOA);
+			console_input(u, *p++, CONSOLE_ARG);
+		console_input(u, '\n', i == argc - 1 ? CONSOLE_END : CONSOLE_EOA);
 	}
 }
 
 void
-console_deo(Uint8 addr)
+console_deo(Uxn *u, Uint8 addr)
 {
 	FILE *fd;
 	switch(addr) {
-	case 0x11: console_vector = PEEK2(&uxn.dev[0x10]); return;
-	case 0x18: fd = stdout, fputc(uxn.dev[0x18], fd), fflush(fd); break;
-	case 0x19: fd = stderr, fputc(uxn.dev[0x19], fd), fflush(fd); break;
+	case 0x11: u->console_vector = PEEK2(&u->dev[0x10]); return;
+	case 0x18: fd = stdout, fputc(u->dev[0x18], fd), fflush(fd); break;
+	case 0x19: fd = stderr, fputc(u->dev[0x19], fd), fflush(fd); break;
 	}
 }
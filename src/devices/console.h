@@ -14,9 +14,7 @@ WITH REGARD TO THIS SOFTWARE.
 #define CONSOLE_EOA 0x3
 #define CONSOLE_END 0x4
 
-int console_input(int c, int type);
-void console_arguments(int i, int argc, char **argv);
-Uint8 console_dei(Uint8 addr);
-void console_deo(Uint8 addr);
-
-extern int console_vector;
+int console_input(Uxn *u, int c, int type);
+void console_arguments(Uxn *u, int i, int argc, char **argv);
+Uint8 console_dei(Uxn *u, Uint8 addr);
+void console_deo(Uxn *u, Uint8 addr);
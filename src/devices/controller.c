@@ -12,40 +12,38 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
-static int controller_vector;
-
 void
-controller_down(Uint8 mask)
+controller_down(Uxn *u, Uint8 mask)
 {
 	if(mask) {
-		uxn.dev[0x82] |= mask;
-		uxn_eval(controller_vector);
+		u->dev[0x82] |= mask;
+		uxn_eval(u, u->controller_vector);
 	}
 }
 
 void
-controller_up(Uint8 mask)
+controller_up(Uxn *u, Uint8 mask)
 {
 	if(mask) {
-		uxn.dev[0x82] &= (~mask);
-		uxn_eval(controller_vector);
+		u->dev[0x82] &= (~mask);
+		uxn_eval(u, u->controller_vector);
 	}
 }
 
 void
-controller_key(Uint8 key)
+controller_key(Uxn *u, Uint8 key)
 {
 	if(key) {
-		uxn.dev[0x83] = key;
-		uxn_eval(controller_vector);
-		uxn.dev[0x83] = 0;
+		u->dev[0x83] = key;
+		uxn_eval(u, u->controller_vector);
+		u->dev[0x83] = 0;
 	}
 }
 
 void
-controller_deo(Uint8 addr)
+controller_deo(Uxn *u, Uint8 addr)
 {
 	switch(addr) {
-	case 0x81: controller_vector = PEEK2(&uxn.dev[0x80]); break;
+	case 0x81: u->controller_vector = PEEK2(&u->dev[0x80]); break;
 	}
 }
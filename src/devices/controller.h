@@ -9,8 +9,8 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
-void controller_down(Uint8 mask);
-void controller_up(Uint8 mask);
-void controller_key(Uint8 key);
+void controller_down(Uxn *u, Uint8 mask);
+void controller_up(Uxn *u, Uint8 mask);
+void controller_key(Uxn *u, Uint8 key);
 
-void controller_deo(Uint8 addr);
+void controller_deo(Uxn *u, Uint8 addr);
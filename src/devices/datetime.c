@@ -1,3 +1,7 @@
+#if !defined(_WIN32) && !defined(__plan9__)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <time.h>
 
 #include "../uxn.h"
@@ -15,13 +19,20 @@ WITH REGARD TO THIS SOFTWARE.
 */
 
 Uint8
-datetime_dei(Uint8 addr)
+datetime_dei(Uxn *u, Uint8 addr)
 {
 	time_t seconds = time(NULL);
 	struct tm zt = {0};
-	struct tm *t = localtime(&seconds);
-	if(t == NULL)
+	struct tm *t = &zt;
+	/* localtime shares one buffer between the machines of uxncli -n */
+#if defined(_WIN32)
+	localtime_s(&zt, &seconds);
+#elif defined(__plan9__)
+	if((t = localtime(&seconds)) == NULL)
 		t = &zt;
+#else
+	localtime_r(&seconds, &zt);
+#endif
 	switch(addr) {
 	case 0xc0: return (t->tm_year + 1900) >> 8;
 	case 0xc1: return (t->tm_year + 1900);
@@ -34,6 +45,6 @@ datetime_dei(Uint8 addr)
 	case 0xc8: return t->tm_yday >> 8;
 	case 0xc9: return t->tm_yday;
 	case 0xca: return t->tm_isdst;
-	default: return uxn.dev[addr];
+	default: return u->dev[addr];
 	}
 }
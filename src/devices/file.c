@@ -30,6 +30,7 @@
 #endif
 
 #include "../uxn.h"
+#include "system.h"
 #include "file.h"
 
 /*
@@ -43,7 +44,7 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
-typedef struct {
+typedef struct UxnFile {
 	FILE *f;
 	DIR *dir;
 	char current_filename[4096];
@@ -57,8 +58,6 @@ typedef struct {
 	int outside_sandbox;
 } UxnFile;
 
-static UxnFile uxn_file[POLYFILEY];
-
 static void
 reset(UxnFile *c)
 {
@@ -94,7 +93,7 @@ get_entry(char *p, Uint16 len, const char *pathname, const char *basename, int f
 static Uint16
 file_read_dir(UxnFile *c, char *dest, Uint16 len)
 {
-	static char pathname[4352];
+	char pathname[4352];
 	char *p = dest;
 	if(c->de == NULL) c->de = readdir(c->dir);
 	for(; c->de != NULL; c->de = readdir(c->dir)) {
@@ -312,76 +311,94 @@ file_delete(UxnFile *c)
 /* IO */
 
 void
-file_deo(Uint8 port)
+file_release(Uxn *u)
+{
+	int i;
+	if(!u->file) return;
+	for(i = 0; i < POLYFILEY; i++)
+		reset(&u->file[i]);
+	free(u->file);
+	u->file = NULL;
+}
+
+void
+file_deo(Uxn *u, Uint8 port)
 {
 	Uint16 addr, len, res;
+	UxnFile *uxn_file = u->file;
+	if(!uxn_file && !(uxn_file = u->file = calloc(POLYFILEY, sizeof(UxnFile))))
+		return;
 	switch(port) {
 	case 0xa5:
-		addr = PEEK2(&uxn.dev[0xa4]);
-		len = PEEK2(&uxn.dev[0xaa]);
+		addr = PEEK2(&u->dev[0xa4]);
+		len = PEEK2(&u->dev[0xaa]);
 		if(len > 0x10000 - addr)
 			len = 0x10000 - addr;
-		res = file_stat(&uxn_file[0], &uxn.ram[addr], len);
-		POKE2(&uxn.dev[0xa2], res);
+		res = file_stat(&uxn_file[0], &u->ram[addr], len);
+		system_written(u, 0, addr, res);
+		POKE2(&u->dev[0xa2], res);
 		break;
 	case 0xa6:
 		res = file_delete(&uxn_file[0]);
-		POKE2(&uxn.dev[0xa2], res);
+		POKE2(&u->dev[0xa2], res);
 		break;
 	case 0xa9:
-		addr = PEEK2(&uxn.dev[0xa8]);
-		res = file_init(&uxn_file[0], (char *)&uxn.ram[addr], 0x10000 - addr, 0);
-		POKE2(&uxn.dev[0xa2], res);
+		addr = PEEK2(&u->dev[0xa8]);
+		res = file_init(&uxn_file[0], (char *)&u->ram[addr], 0x10000 - addr, 0);
+		POKE2(&u->dev[0xa2], res);
 		break;
 	case 0xad:
-		addr = PEEK2(&uxn.dev[0xac]);
-		len = PEEK2(&uxn.dev[0xaa]);
+		addr = PEEK2(&u->dev[0xac]);
+		len = PEEK2(&u->dev[0xaa]);
 		if(len > 0x10000 - addr)
 			len = 0x10000 - addr;
-		res = file_read(&uxn_file[0], &uxn.ram[addr], len);
-		POKE2(&uxn.dev[0xa2], res);
+		res = file_read(&uxn_file[0], &u->ram[addr], len);
+		system_written(u, 0, addr, res);
+		POKE2(&u->dev[0xa2], res);
 		break;
 	case 0xaf:
-		addr = PEEK2(&uxn.dev[0xae]);
-		len = PEEK2(&uxn.dev[0xaa]);
+		addr = PEEK2(&u->dev[0xae]);
+		len = PEEK2(&u->dev[0xaa]);
 		if(len > 0x10000 - addr)
 			len = 0x10000 - addr;
-		res = file_write(&uxn_file[0], &uxn.ram[addr], len, uxn.dev[0xa7]);
-		POKE2(&uxn.dev[0xa2], res);
+		res = file_write(&uxn_file[0], &u->ram[addr], len, u->dev[0xa7]);
+		POKE2(&u->dev[0xa2], res);
 		break;
 	/* File 2 */
 	case 0xb5:
-		addr = PEEK2(&uxn.dev[0xb4]);
-		len = PEEK2(&uxn.dev[0xba]);
+		addr = PEEK2(&u->dev[0xb4]);
+		len = PEEK2(&u->dev[0xba]);
 		if(len > 0x10000 - addr)
 			len = 0x10000 - addr;
-		res = file_stat(&uxn_file[1], &uxn.ram[addr], len);
-		POKE2(&uxn.dev[0xb2], res);
+		res = file_stat(&uxn_file[1], &u->ram[addr], len);
+		system_written(u, 0, addr, res);
+		POKE2(&u->dev[0xb2], res);
 		break;
 	case 0xb6:
 		res = file_delete(&uxn_file[1]);
-		POKE2(&uxn.dev[0xb2], res);
+		POKE2(&u->dev[0xb2], res);
 		break;
 	case 0xb9:
-		addr = PEEK2(&uxn.dev[0xb8]);
-		res = file_init(&uxn_file[1], (char *)&uxn.ram[addr], 0x10000 - addr, 0);
-		POKE2(&uxn.dev[0xb2], res);
+		addr = PEEK2(&u->dev[0xb8]);
+		res = file_init(&uxn_file[1], (char *)&u->ram[addr], 0x10000 - addr, 0);
+		POKE2(&u->dev[0xb2], res);
 		break;
 	case 0xbd:
-		addr = PEEK2(&uxn.dev[0xbc]);
-		len = PEEK2(&uxn.dev[0xba]);
+		addr = PEEK2(&u->dev[0xbc]);
+		len = PEEK2(&u->dev[0xba]);
 		if(len > 0x10000 - addr)
 			len = 0x10000 - addr;
-		res = file_read(&uxn_file[1], &uxn.ram[addr], len);
-		POKE2(&uxn.dev[0xb2], res);
+		res = file_read(&uxn_file[1], &u->ram[addr], len);
+		system_written(u, 0, addr, res);
+		POKE2(&u->dev[0xb2], res);
 		break;
 	case 0xbf:
-		addr = PEEK2(&uxn.dev[0xbe]);
-		len = PEEK2(&uxn.dev[0xba]);
+		addr = PEEK2(&u->dev[0xbe]);
+		len = PEEK2(&u->dev[0xba]);
 		if(len > 0x10000 - addr)
 			len = 0x10000 - addr;
-		res = file_write(&uxn_file[1], &uxn.ram[addr], len, uxn.dev[0xb7]);
-		POKE2(&uxn.dev[0xb2], res);
+		res = file_write(&uxn_file[1], &u->ram[addr], len, u->dev[0xb7]);
+		POKE2(&u->dev[0xb2], res);
 		break;
 	}
 }
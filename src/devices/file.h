@@ -12,4 +12,5 @@ WITH REGARD TO THIS SOFTWARE.
 #define POLYFILEY 2
 #define DEV_FILE0 0xa
 
-void file_deo(Uint8 port);
+void file_release(Uxn *u);
+void file_deo(Uxn *u, Uint8 port);
@@ -13,44 +13,42 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
-static int mouse_vector;
-
 void
-mouse_down(Uint8 mask)
+mouse_down(Uxn *u, Uint8 mask)
 {
-	uxn.dev[0x96] |= mask;
-	uxn_eval(mouse_vector);
+	u->dev[0x96] |= mask;
+	uxn_eval(u, u->mouse_vector);
 }
 
 void
-mouse_up(Uint8 mask)
+mouse_up(Uxn *u, Uint8 mask)
 {
-	uxn.dev[0x96] &= (~mask);
-	uxn_eval(mouse_vector);
+	u->dev[0x96] &= (~mask);
+	uxn_eval(u, u->mouse_vector);
 }
 
 void
-mouse_pos(Uint16 x, Uint16 y)
+mouse_pos(Uxn *u, Uint16 x, Uint16 y)
 {
-	uxn.dev[0x92] = x >> 8, uxn.dev[0x93] = x;
-	uxn.dev[0x94] = y >> 8, uxn.dev[0x95] = y;
-	uxn_eval(mouse_vector);
+	u->dev[0x92] = x >> 8, u->dev[0x93] = x;
+	u->dev[0x94] = y >> 8, u->dev[0x95] = y;
+	uxn_eval(u, u->mouse_vector);
 }
 
 void
-mouse_scroll(Uint16 x, Uint16 y)
+mouse_scroll(Uxn *u, Uint16 x, Uint16 y)
 {
-	uxn.dev[0x9a] = x >> 8, uxn.dev[0x9b] = x;
-	uxn.dev[0x9c] = -y >> 8, uxn.dev[0x9d] = -y;
-	uxn_eval(mouse_vector);
-	uxn.dev[0x9a] = 0, uxn.dev[0x9b] = 0;
-	uxn.dev[0x9c] = 0, uxn.dev[0x9d] = 0;
+	u->dev[0x9a] = x >> 8, u->dev[0x9b] = x;
+	u->dev[0x9c] = -y >> 8, u->dev[0x9d] = -y;
+	uxn_eval(u, u->mouse_vector);
+	u->dev[0x9a] = 0, u->dev[0x9b] = 0;
+	u->dev[0x9c] = 0, u->dev[0x9d] = 0;
 }
 
 void
-mouse_deo(Uint8 addr)
+mouse_deo(Uxn *u, Uint8 addr)
 {
 	switch(addr) {
-	case 0x91: mouse_vector = PEEK2(&uxn.dev[0x90]); break;
+	case 0x91: u->mouse_vector = PEEK2(&u->dev[0x90]); break;
 	}
 }
@@ -9,9 +9,9 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
-void mouse_down(Uint8 mask);
-void mouse_up(Uint8 mask);
-void mouse_pos(Uint16 x, Uint16 y);
-void mouse_scroll(Uint16 x, Uint16 y);
+void mouse_down(Uxn *u, Uint8 mask);
+void mouse_up(Uxn *u, Uint8 mask);
+void mouse_pos(Uxn *u, Uint16 x, Uint16 y);
+void mouse_scroll(Uxn *u, Uint16 x, Uint16 y);
 
-void mouse_deo(Uint8 addr);
+void mouse_deo(Uxn *u, Uint8 addr);
@@ -1,5 +1,9 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "../uxn.h"
 #include "screen.h"
 
@@ -27,6 +31,107 @@ static Uint8 blending[4][16] = {
 	{1, 2, 3, 1, 1, 2, 3, 1, 1, 2, 3, 1, 1, 2, 3, 1},
 	{2, 3, 1, 2, 2, 3, 1, 2, 2, 3, 1, 2, 2, 3, 1, 2}};
 
+/* Sprites are drawn a row at a time. The four colours of a sprite command
+are resolved once per blend mode and palette slot, and each byte of a
+row selects its eight pixels through a table of lane masks, flipped rows
+going through a table of reversed bytes first. Once the colours are known
+a blend mode only decides whether colour 0 is drawn, so there is a kernel
+for each depth, flip and opacity, picked once per command. */
+
+static Uint8 sprite_lanes[256][8], sprite_colors[4], sprite_flip[256];
+static int sprite_key = -1;
+#ifdef __SSE2__
+static __m128i sprite_vec[4];
+#endif
+
+static void
+sprite_resolve(int key)
+{
+	int i, k;
+	if(!sprite_lanes[1][7])
+		for(i = 0; i < 256; i++)
+			for(k = 0; k < 8; k++) {
+				sprite_lanes[i][k] = (i >> (7 - k)) & 1 ? 0xff : 0;
+				sprite_flip[i] |= ((i >> k) & 1) << (7 - k);
+			}
+	for(i = 0; i < 4; i++) {
+		sprite_colors[i] = (key >> 4) << 2 | blending[i][key & 0xf];
+#ifdef __SSE2__
+		sprite_vec[i] = _mm_set1_epi8(sprite_colors[i]);
+#endif
+	}
+	sprite_key = key;
+}
+
+static void
+sprite_row(Uint8 *dst, int ch1, int ch2, int twobpp, int opaque)
+{
+#ifdef __SSE2__
+	__m128i m1 = _mm_loadl_epi64((__m128i *)sprite_lanes[ch1]), m2, hi, m = m1;
+	__m128i px = _mm_or_si128(_mm_and_si128(m1, sprite_vec[1]), _mm_andnot_si128(m1, sprite_vec[0]));
+	if(twobpp) {
+		m2 = _mm_loadl_epi64((__m128i *)sprite_lanes[ch2]), m = _mm_or_si128(m1, m2);
+		hi = _mm_or_si128(_mm_and_si128(m1, sprite_vec[3]), _mm_andnot_si128(m1, sprite_vec[2]));
+		px = _mm_or_si128(_mm_and_si128(m2, hi), _mm_andnot_si128(m2, px));
+	}
+	if(!opaque)
+		px = _mm_or_si128(_mm_and_si128(m, px), _mm_andnot_si128(m, _mm_loadl_epi64((__m128i *)dst)));
+	_mm_storel_epi64((__m128i *)dst, px);
+#else
+	int k, color;
+	for(k = 0; k < 8; k++) {
+		color = (sprite_lanes[ch1][k] & 1) | (twobpp ? sprite_lanes[ch2][k] & 2 : 0);
+		if(opaque || color) dst[k] = sprite_colors[color];
+	}
+#endif
+}
+
+/* clang-format off */
+
+#define SPRITE_KERNEL(name, twobpp, flipy, flipx, opaque) \
+static void \
+name(Uint8 *row, Uint8 *sprite, int stride) \
+{ \
+	int y, qy, ch1, ch2 = 0; \
+	for(y = 0; y < 8; y++, row += stride) { \
+		qy = flipy ? 7 - y : y, ch1 = sprite[qy]; \
+		if(twobpp) ch2 = sprite[qy + 8]; \
+		if(flipx) ch1 = sprite_flip[ch1], ch2 = sprite_flip[ch2]; \
+		sprite_row(row, ch1, ch2, twobpp, opaque); \
+	} \
+}
+
+#define SPRITE_KERNELS \
+	K(0,0,0,0) K(0,0,0,1) K(0,0,1,0) K(0,0,1,1) K(0,1,0,0) K(0,1,0,1) K(0,1,1,0) K(0,1,1,1) \
+	K(1,0,0,0) K(1,0,0,1) K(1,0,1,0) K(1,0,1,1) K(1,1,0,0) K(1,1,0,1) K(1,1,1,0) K(1,1,1,1)
+
+#define K(d, fy, fx, op) SPRITE_KERNEL(sprite_##d##fy##fx##op, d, fy, fx, op)
+SPRITE_KERNELS
+#undef K
+
+#define K(d, fy, fx, op) sprite_##d##fy##fx##op,
+static void (*sprite_kernels[16])(Uint8 *row, Uint8 *sprite, int stride) = {SPRITE_KERNELS};
+#undef K
+
+/* clang-format on */
+
+/* Wide layers are drawn a pixel at a time, a fallback that only has to be
+right. */
+
+static void
+sprite_wide(Uint16 *row, Uint8 *sprite, int stride, int ctrl, Uint16 *colors)
+{
+	int x, y, qy, c, opaque = (ctrl & 0xf) % 5;
+	for(y = 0; y < 8; y++, row += stride) {
+		qy = ctrl & 0x20 ? 7 - y : y;
+		for(x = 0; x < 8; x++) {
+			int bit = ctrl & 0x10 ? x : 7 - x;
+			c = (sprite[qy] >> bit & 1) | (ctrl & 0x80 ? (sprite[qy + 8] >> bit & 1) << 1 : 0);
+			if(opaque || c) row[x] = colors[c];
+		}
+	}
+}
+
 int
 screen_changed(void)
 {
@@ -38,36 +143,145 @@ screen_changed(void)
 		uxn_screen.y2 > uxn_screen.y1;
 }
 
+/* Besides the bounding box, drawing marks the tiles of TILE_SIZE pixels
+it touched, so that only those are uploaded. */
+
 static void
 screen_change(int x1, int y1, int x2, int y2)
 {
+	int tx, ty;
 	if(x1 < uxn_screen.x1) uxn_screen.x1 = x1;
 	if(y1 < uxn_screen.y1) uxn_screen.y1 = y1;
 	if(x2 > uxn_screen.x2) uxn_screen.x2 = x2;
 	if(y2 > uxn_screen.y2) uxn_screen.y2 = y2;
+	clamp(x1, 0, uxn_screen.width);
+	clamp(y1, 0, uxn_screen.height);
+	clamp(x2, 0, uxn_screen.width);
+	clamp(y2, 0, uxn_screen.height);
+	if(x2 <= x1 || y2 <= y1 || !uxn_screen.tiles) return;
+	for(ty = y1 >> TILE_SHIFT; ty <= (y2 - 1) >> TILE_SHIFT; ty++)
+		for(tx = x1 >> TILE_SHIFT; tx <= (x2 - 1) >> TILE_SHIFT; tx++)
+			uxn_screen.tiles[ty * uxn_screen.tiles_w + tx] = 1;
+}
+
+/* A fill is clipped to the screen and written a row at a time, each row
+one memset of colour bytes, and only the clipped rectangle is damaged. */
+
+static void
+screen_fill(int fg, int x1, int y1, int x2, int y2, int color)
+{
+	int x, y, stride = MAR2(uxn_screen.width);
+	Uint8 *layer = fg ? uxn_screen.fg : uxn_screen.bg;
+	Uint16 *wide = fg ? uxn_screen.fg16 : uxn_screen.bg16;
+	clamp(x1, 0, uxn_screen.width);
+	clamp(y1, 0, uxn_screen.height);
+	clamp(x2, 0, uxn_screen.width);
+	clamp(y2, 0, uxn_screen.height);
+	if(x2 <= x1 || y2 <= y1) return;
+	for(y = y1; y < y2; y++)
+		if(uxn_screen.wide)
+			for(x = x1; x < x2; x++)
+				wide[MAR(y) * stride + MAR(x)] = color;
+		else
+			memset(layer + MAR(y) * stride + MAR(x1), color, x2 - x1);
+	screen_change(x1, y1, x2, y2);
+}
+
+/* Layers keep the palette slot pixels were drawn with, so a palette change
+does not recolour them. A new palette takes a slot the first time it is
+drawn with, or the slot of the same palette if one is still held. Once all
+are held, a scan of the visible layers frees the ones no pixel uses, and
+should none be free the layers are widened, each pixel taking the colour
+of its slot. Only if that cannot be allocated do the pixels of the next
+slot take the new palette. */
+
+static Uint32 palette_next[4];
+static Uint16 palette_wide[4];
+static int palette_pending;
+static Uint8 slot_held[SLOTS] = {1};
+
+#define RGB12(c) (((c) >> 12 & 0xf00) | ((c) >> 8 & 0xf0) | ((c) >> 4 & 0xf))
+
+static int
+screen_widen(void)
+{
+	int i, len = MAR2(uxn_screen.width) * MAR2(uxn_screen.height);
+	Uint16 *fg = malloc(len * sizeof(Uint16)), *bg = malloc(len * sizeof(Uint16));
+	if(!fg || !bg) {
+		free(fg), free(bg);
+		return 0;
+	}
+	for(i = 0; i < len; i++) {
+		fg[i] = uxn_screen.fg[i] & 3 ? WIDE_FG | RGB12(uxn_screen.colors[uxn_screen.fg[i]]) : 0;
+		bg[i] = RGB12(uxn_screen.colors[uxn_screen.bg[i]]);
+	}
+	uxn_screen.fg16 = fg, uxn_screen.bg16 = bg, uxn_screen.wide = 1;
+	return 1;
+}
+
+/* The colour a wide layer is drawn with, 0 on the foreground being
+transparent. */
+
+static Uint16
+screen_wide(int fg, int color)
+{
+	return fg ? (color ? WIDE_FG | palette_wide[color] : 0) : palette_wide[color];
+}
+
+static void
+screen_collect(void)
+{
+	int x, y, i, stride = MAR2(uxn_screen.width);
+	memset(slot_held, 0, sizeof(slot_held));
+	for(y = MAR(0); y < MAR(uxn_screen.height); y++)
+		for(x = MAR(0), i = y * stride + x; x < MAR(uxn_screen.width); x++, i++) {
+			if(uxn_screen.fg[i] & 3) slot_held[uxn_screen.fg[i] >> 2] = 1;
+			slot_held[uxn_screen.bg[i] >> 2] = 1;
+		}
+}
+
+static int
+screen_slot(void)
+{
+	int s;
+	if(!palette_pending || uxn_screen.wide) return uxn_screen.slot;
+	palette_pending = 0;
+	for(s = 0; s < SLOTS; s++)
+		if(slot_held[s] && !memcmp(&uxn_screen.colors[s * 4], palette_next, sizeof(palette_next)))
+			return uxn_screen.slot = s;
+	for(s = 0; s < SLOTS && slot_held[s]; s++);
+	if(s == SLOTS) {
+		screen_collect();
+		for(s = 0; s < SLOTS && slot_held[s]; s++);
+		if(s == SLOTS && screen_widen())
+			return uxn_screen.slot;
+		if(s == SLOTS)
+			s = (uxn_screen.slot + 1) % SLOTS, screen_change(0, 0, uxn_screen.width, uxn_screen.height);
+	}
+	memcpy(&uxn_screen.colors[s * 4], palette_next, sizeof(palette_next));
+	slot_held[s] = 1;
+	return uxn_screen.slot = s;
 }
 
 void
-screen_palette(void)
+screen_palette(Uxn *u)
 {
-	int i, shift, colors[4];
+	int i, shift;
 	for(i = 0, shift = 4; i < 4; ++i, shift ^= 4) {
-		Uint8
-			r = (uxn.dev[0x8 + i / 2] >> shift) & 0xf,
-			g = (uxn.dev[0xa + i / 2] >> shift) & 0xf,
-			b = (uxn.dev[0xc + i / 2] >> shift) & 0xf;
-		colors[i] = 0xf000 | r << 8 | g << 4 | b;
+		Uint32
+			r = (u->dev[0x8 + i / 2] >> shift) & 0xf,
+			g = (u->dev[0xa + i / 2] >> shift) & 0xf,
+			b = (u->dev[0xc + i / 2] >> shift) & 0xf;
+		palette_next[i] = 0xff000000 | r * 0x110000 | g * 0x1100 | b * 0x11;
+		palette_wide[i] = r << 8 | g << 4 | b;
 	}
-	for(i = 0; i < 8; i++){ 
-    uxn_screen.palette[i] = colors[i%4];
-  }
-  uxn_screen.palette[4] = 0;
+	palette_pending = 1;
 }
 
 void
 screen_resize(Uint16 width, Uint16 height, int scale)
 {
-	Uint16 *pixels;
+	Uint8 *pixels;
 	clamp(width, 8, 0x800);
 	clamp(height, 8, 0x800);
 	clamp(scale, 1, 3);
@@ -76,142 +290,132 @@ screen_resize(Uint16 width, Uint16 height, int scale)
 		int len = MAR2(width) * MAR2(height);
     uxn_screen.width = width, uxn_screen.height = height;
     
-    pixels = realloc(uxn_screen.fg, len * sizeof(Uint16));
+    pixels = realloc(uxn_screen.fg, len);
     if(!pixels) return;
     uxn_screen.fg = pixels;
 
-    pixels = realloc(uxn_screen.bg, len * sizeof(Uint16));
+    pixels = realloc(uxn_screen.bg, len);
     if(!pixels) return;
     uxn_screen.bg = pixels;
+
+		/* a cleared screen holds no slot but the current palette's */
+		free(uxn_screen.fg16), free(uxn_screen.bg16);
+		uxn_screen.fg16 = uxn_screen.bg16 = NULL, uxn_screen.wide = 0;
+		memset(slot_held, 0, sizeof(slot_held));
+		palette_pending = 1;
+		memset(uxn_screen.fg, 0, len);
+		memset(uxn_screen.bg, screen_slot() << 2, len);
+
+		uxn_screen.tiles_w = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+		uxn_screen.tiles_h = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+		free(uxn_screen.tiles);
+		uxn_screen.tiles = malloc(uxn_screen.tiles_w * uxn_screen.tiles_h);
 	}
 	screen_change(0, 0, width, height);
 	emu_resize(width, height);
 }
 
-/* screen registers */
-
-static int rX, rY, rA, rMX, rMY, rMA, rML, rDX, rDY;
-
 Uint8
-screen_dei(Uint8 addr)
+screen_dei(Uxn *u, Uint8 addr)
 {
 	switch(addr) {
 	case 0x22: return uxn_screen.width >> 8;
 	case 0x23: return uxn_screen.width;
 	case 0x24: return uxn_screen.height >> 8;
 	case 0x25: return uxn_screen.height;
-	case 0x28: return rX >> 8;
-	case 0x29: return rX;
-	case 0x2a: return rY >> 8;
-	case 0x2b: return rY;
-	case 0x2c: return rA >> 8;
-	case 0x2d: return rA;
-	default: return uxn.dev[addr];
+	case 0x28: return u->rX >> 8;
+	case 0x29: return u->rX;
+	case 0x2a: return u->rY >> 8;
+	case 0x2b: return u->rY;
+	case 0x2c: return u->rA >> 8;
+	case 0x2d: return u->rA;
+	default: return u->dev[addr];
 	}
 }
 
 void
-screen_deo(Uint8 addr)
+screen_deo(Uxn *u, Uint8 addr)
 {
 	switch(addr) {
-	case 0x21: uxn_screen.vector = PEEK2(&uxn.dev[0x20]); return;
-	case 0x23: screen_resize(PEEK2(&uxn.dev[0x22]), uxn_screen.height, uxn_screen.scale); return;
-	case 0x25: screen_resize(uxn_screen.width, PEEK2(&uxn.dev[0x24]), uxn_screen.scale); return;
-	case 0x26: rMX = uxn.dev[0x26] & 0x1, rMY = uxn.dev[0x26] & 0x2, rMA = uxn.dev[0x26] & 0x4, rML = uxn.dev[0x26] >> 4, rDX = rMX << 3, rDY = rMY << 2; return;
+	case 0x21: uxn_screen.vector = PEEK2(&u->dev[0x20]); return;
+	case 0x23: screen_resize(PEEK2(&u->dev[0x22]), uxn_screen.height, uxn_screen.scale); return;
+	case 0x25: screen_resize(uxn_screen.width, PEEK2(&u->dev[0x24]), uxn_screen.scale); return;
+	case 0x26: u->rMX = u->dev[0x26] & 0x1, u->rMY = u->dev[0x26] & 0x2, u->rMA = u->dev[0x26] & 0x4, u->rML = u->dev[0x26] >> 4, u->rDX = u->rMX << 3, u->rDY = u->rMY << 2; return;
 	case 0x28:
-	case 0x29: rX = (uxn.dev[0x28] << 8) | uxn.dev[0x29], rX = twos(rX); return;
+	case 0x29: u->rX = (u->dev[0x28] << 8) | u->dev[0x29], u->rX = twos(u->rX); return;
 	case 0x2a:
-	case 0x2b: rY = (uxn.dev[0x2a] << 8) | uxn.dev[0x2b], rY = twos(rY); return;
+	case 0x2b: u->rY = (u->dev[0x2a] << 8) | u->dev[0x2b], u->rY = twos(u->rY); return;
 	case 0x2c:
-	case 0x2d: rA = (uxn.dev[0x2c] << 8) | uxn.dev[0x2d]; return;
+	case 0x2d: u->rA = (u->dev[0x2c] << 8) | u->dev[0x2d]; return;
 	case 0x2e: {
-		int ctrl = uxn.dev[0x2e];
-		int color = uxn_screen.palette[(ctrl & 0x3)+((ctrl & 0x40) >> 4)];
-		int len = MAR2(uxn_screen.width);
-		Uint16 *layer = ctrl & 0x40 ? uxn_screen.fg : uxn_screen.bg;
+		int ctrl = u->dev[0x2e];
+		int color = screen_slot() << 2 | (ctrl & 0x3);
+		if(uxn_screen.wide) color = screen_wide(ctrl & 0x40, ctrl & 0x3);
 		/* fill mode */
 		if(ctrl & 0x80) {
-			int x1, y1, x2, y2, ax, bx, ay, by, hor, ver;
+			int x1, y1, x2, y2;
 			if(ctrl & 0x10)
-				x1 = 0, x2 = rX;
+				x1 = 0, x2 = u->rX;
 			else
-				x1 = rX, x2 = uxn_screen.width;
+				x1 = u->rX, x2 = uxn_screen.width;
 			if(ctrl & 0x20)
-				y1 = 0, y2 = rY;
+				y1 = 0, y2 = u->rY;
 			else
-				y1 = rY, y2 = uxn_screen.height;
-			x1 = MAR(x1), y1 = MAR(y1);
-			hor = MAR(x2) - x1, ver = MAR(y2) - y1;
-			for(ay = y1 * len, by = ay + ver * len; ay < by; ay += len)
-				for(ax = ay + x1, bx = ax + hor; ax < bx; ax++)
-					layer[ax] = color;
+				y1 = u->rY, y2 = uxn_screen.height;
+			screen_fill(ctrl & 0x40, x1, y1, x2, y2, color);
 		}
 		/* pixel mode */
 		else {
-			if(rX >= 0 && rY >= 0 && rX < len && rY < uxn_screen.height)
-				layer[MAR(rX) + MAR(rY) * len] = color;
-			if(rMX) rX++;
-			if(rMY) rY++;
+			if(u->rX >= 0 && u->rY >= 0 && u->rX < uxn_screen.width && u->rY < uxn_screen.height) {
+				int i = MAR(u->rX) + MAR(u->rY) * MAR2(uxn_screen.width);
+				if(uxn_screen.wide)
+					(ctrl & 0x40 ? uxn_screen.fg16 : uxn_screen.bg16)[i] = color;
+				else
+					(ctrl & 0x40 ? uxn_screen.fg : uxn_screen.bg)[i] = color;
+				screen_change(u->rX, u->rY, u->rX + 1, u->rY + 1);
+			}
+			if(u->rMX) u->rX++;
+			if(u->rMY) u->rY++;
 		}
 		return;
 	}
 	case 0x2f: {
-		int ctrl = uxn.dev[0x2f];
+		int ctrl = u->dev[0x2f];
 		int blend = ctrl & 0xf, opaque = blend % 5;
 		int fx = ctrl & 0x10 ? -1 : 1, fy = ctrl & 0x20 ? -1 : 1;
-		int qfx = fx > 0 ? 7 : 0, qfy = fy < 0 ? 7 : 0;
-		int dxy = fy * rDX, dyx = fx * rDY;
+		int dxy = fy * u->rDX, dyx = fx * u->rDY;
 		int wmar = MAR(uxn_screen.width), wmar2 = MAR2(uxn_screen.width);
 		int hmar2 = MAR2(uxn_screen.height);
-		int i, x1, x2, y1, y2, ax, ay, qx, qy, x = rX, y = rY;
-		Uint16 *layer = ctrl & 0x40 ? uxn_screen.fg : uxn_screen.bg;
-    int coltype = (ctrl & 0x40) >> 4;
-		if(ctrl & 0x80) {
-			int addr_incr = rMA << 2;
-			for(i = 0; i <= rML; i++, x += dyx, y += dxy, rA += addr_incr) {
-				Uint16 xmar = MAR(x), ymar = MAR(y);
-				Uint16 xmar2 = MAR2(x), ymar2 = MAR2(y);
-				if(xmar < wmar && ymar2 < hmar2) {
-					Uint8 *sprite = &uxn.ram[rA];
-					int by = ymar2 * wmar2;
-					for(ay = ymar * wmar2, qy = qfy; ay < by; ay += wmar2, qy += fy) {
-						int ch1 = sprite[qy], ch2 = sprite[qy + 8] << 1, bx = xmar2 + ay;
-						for(ax = xmar + ay, qx = qfx; ax < bx; ax++, qx -= fx) {
-							int color = ((ch1 >> qx) & 1) | ((ch2 >> qx) & 2);
-							if(opaque || color) layer[ax] = uxn_screen.palette[coltype+blending[color][blend]];
-						}
-					}
-				}
-			}
-		} else {
-			int addr_incr = rMA << 1;
-			for(i = 0; i <= rML; i++, x += dyx, y += dxy, rA += addr_incr) {
-				Uint16 xmar = MAR(x), ymar = MAR(y);
-				Uint16 xmar2 = MAR2(x), ymar2 = MAR2(y);
-				if(xmar < wmar && ymar2 < hmar2) {
-					Uint8 *sprite = &uxn.ram[rA];
-					int by = ymar2 * wmar2;
-					for(ay = ymar * wmar2, qy = qfy; ay < by; ay += wmar2, qy += fy) {
-						int ch1 = sprite[qy], bx = xmar2 + ay;
-						for(ax = xmar + ay, qx = qfx; ax < bx; ax++, qx -= fx) {
-							int color = (ch1 >> qx) & 1;
-							if(opaque || color) layer[ax] = uxn_screen.palette[coltype+blending[color][blend]];
-						}
-					}
-				}
+		int i, x1, x2, y1, y2, x = u->rX, y = u->rY;
+		Uint8 *layer = ctrl & 0x40 ? uxn_screen.fg : uxn_screen.bg;
+		Uint16 *wide = ctrl & 0x40 ? uxn_screen.fg16 : uxn_screen.bg16, colors[4];
+		int addr_incr = u->rMA << (ctrl & 0x80 ? 2 : 1);
+		void (*kernel)(Uint8 *, Uint8 *, int) = sprite_kernels[(ctrl >> 4 & 0x8) | (ctrl >> 3 & 0x6) | !!opaque];
+		if((screen_slot() << 4 | blend) != sprite_key)
+			sprite_resolve(uxn_screen.slot << 4 | blend);
+		if(uxn_screen.wide)
+			for(i = 0; i < 4; i++)
+				colors[i] = screen_wide(ctrl & 0x40, blending[i][blend]);
+		for(i = 0; i <= u->rML; i++, x += dyx, y += dxy, u->rA = (u->rA + addr_incr) & 0xffff) {
+			Uint16 xmar = MAR(x), ymar = MAR(y), ymar2 = MAR2(y);
+			if(xmar < wmar && ymar < ymar2 && ymar2 < hmar2) {
+				if(uxn_screen.wide)
+					sprite_wide(wide + ymar * wmar2 + xmar, &u->ram[u->rA], wmar2, ctrl, colors);
+				else
+					kernel(layer + ymar * wmar2 + xmar, &u->ram[u->rA], wmar2);
 			}
 		}
 		if(fx < 0)
-			x1 = x, x2 = rX;
+			x1 = x, x2 = u->rX;
 		else
-			x1 = rX, x2 = x;
+			x1 = u->rX, x2 = x;
 		if(fy < 0)
-			y1 = y, y2 = rY;
+			y1 = y, y2 = u->rY;
 		else
-			y1 = rY, y2 = y;
+			y1 = u->rY, y2 = y;
 		screen_change(x1 - 8, y1 - 8, x2 + 8, y2 + 8);
-		if(rMX) rX += rDX * fx;
-		if(rMY) rY += rDY * fy;
+		if(u->rMX) u->rX += u->rDX * fx;
+		if(u->rMY) u->rY += u->rDY * fy;
 		return;
 	}
 	}
@@ -9,19 +9,36 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
+#define TILE_SHIFT 5
+#define TILE_SIZE (1 << TILE_SHIFT)
+
+#define SLOTS 0x40
+
+/* A pixel is a colour index in the low two bits and a palette slot in the
+upper six, resolved to ARGB through colors, on the foreground index 0 is
+transparent. Once more palettes are on screen than there are slots, the
+layers are widened into fg16 and bg16 until the next resize, and a pixel
+holds its own 12-bit colour instead, WIDE_FG set where the foreground is
+drawn. */
+
+#define WIDE_FG 0x1000
+#define WIDE_ARGB(v) (0xff000000 | ((v) & 0xf00) * 0x1100 | ((v) & 0xf0) * 0x110 | ((v) & 0xf) * 0x11)
+
 typedef struct UxnScreen {
-	int width, height, vector, x1, y1, x2, y2, scale;
-	Uint16 palette[8], *fg, *bg;
+	int width, height, vector, x1, y1, x2, y2, scale, tiles_w, tiles_h, slot, wide;
+	Uint32 colors[SLOTS * 4];
+	Uint8 *fg, *bg, *tiles;
+	Uint16 *fg16, *bg16;
 } UxnScreen;
 
 extern UxnScreen uxn_screen;
 extern int emu_resize(int width, int height);
 int screen_changed(void);
-void screen_palette(void);
+void screen_palette(Uxn *u);
 void screen_resize(Uint16 width, Uint16 height, int scale);
 
-Uint8 screen_dei(Uint8 addr);
-void screen_deo(Uint8 addr);
+Uint8 screen_dei(Uxn *u, Uint8 addr);
+void screen_deo(Uxn *u, Uint8 addr);
 
 /* clang-format off */
 
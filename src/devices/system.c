@@ -1,4 +1,21 @@
+#if !defined(_WIN32) && !defined(__plan9__)
+#define _DEFAULT_SOURCE
+#define RAM_MMAP
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef RAM_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#define ROM_CACHE 8
+#endif
 
 #include "../uxn.h"
 #include "system.h"
@@ -14,9 +31,10 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
-#define PAGE_INDEX(bank, addr) ((bank) * PAGE_SIZE + ((addr) & PAGE_MASK))
+#define PAGE_INDEX(bank, addr) ((size_t)(bank) * PAGE_SIZE + ((addr) & PAGE_MASK))
+#define RAM_SLACK 0x100
 
-char *boot_path;
+unsigned int ram_pages = RAM_PAGES;
 
 static void
 system_print(char *name, Stack *s)
@@ -28,18 +46,120 @@ system_print(char *name, Stack *s)
 	fprintf(stderr, "<%02x\n", s->ptr);
 }
 
+/* Roms are mapped once and kept by path, size and time of change, so that
+booting the same rom again copies it from memory. A rom changed on disk
+is mapped anew. */
+
+#ifdef ROM_CACHE
+typedef struct {
+	char *path;
+	time_t mtime;
+	size_t size;
+	Uint8 *data;
+} Rom;
+
+static Rom roms[ROM_CACHE];
+static unsigned int roms_next;
+
+static Rom *
+system_rom(char *rom_path)
+{
+	int i, fd;
+	struct stat st;
+	void *data = NULL;
+	Rom *r = NULL;
+	if(stat(rom_path, &st)) return NULL;
+	for(i = 0; i < ROM_CACHE; i++) {
+		if(!roms[i].path || strcmp(roms[i].path, rom_path)) continue;
+		if(roms[i].mtime == st.st_mtime && roms[i].size == (size_t)st.st_size) return &roms[i];
+		r = &roms[i];
+	}
+	if((fd = open(rom_path, O_RDONLY)) < 0) return NULL;
+	if(st.st_size) data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) return NULL;
+	if(!r) r = &roms[roms_next++ % ROM_CACHE];
+	if(r->data) munmap(r->data, r->size);
+	free(r->path);
+	if((r->path = malloc(strlen(rom_path) + 1))) strcpy(r->path, rom_path);
+	r->mtime = st.st_mtime, r->size = st.st_size, r->data = data;
+	return r;
+}
+
+static int
+system_load(Uxn *u, char *rom_path)
+{
+	unsigned int i, start;
+	size_t at = 0, n;
+	Rom *r = system_rom(rom_path);
+	if(!r) return 0;
+	for(i = 0; i < ram_pages && at < r->size; i++, at += n) {
+		start = i ? 0 : PAGE_PROGRAM;
+		n = r->size - at < PAGE_SIZE - start ? r->size - at : PAGE_SIZE - start;
+		memcpy(u->ram + PAGE_INDEX(i, start), r->data + at, n);
+		system_written(u, i, start, n);
+	}
+	return 1;
+}
+#else
 static int
-system_load(Uint8 *ram, char *rom_path)
+system_load(Uxn *u, char *rom_path)
 {
 	FILE *f = fopen(rom_path, "rb");
 	if(f) {
-		int i = 0, l = fread(ram, PAGE_SIZE - PAGE_PROGRAM, 1, f);
-		while(l && ++i < RAM_PAGES)
-			l = fread(ram + PAGE_SIZE * i - PAGE_PROGRAM, PAGE_SIZE, 1, f);
+		unsigned int i = 0, l = fread(u->ram + PAGE_PROGRAM, 1, PAGE_SIZE - PAGE_PROGRAM, f);
+		system_written(u, 0, PAGE_PROGRAM, l);
+		while(l && ++i < ram_pages)
+			system_written(u, i, 0, l = fread(u->ram + PAGE_INDEX(i, 0), 1, PAGE_SIZE, f));
 		fclose(f);
 	}
 	return !!f;
 }
+#endif
+
+/* Banks are reserved up front and only take memory once touched, where
+the system allows it. Either side of ram is some slack for reads that run
+over its ends, as relative loads near address 0 do in the cores that do
+not wrap them. */
+
+Uint8 *
+system_ram(void)
+{
+	size_t size = (size_t)ram_pages * PAGE_SIZE;
+	Uint8 *ram;
+	if(size / PAGE_SIZE != ram_pages || size > (size_t)-1 - RAM_SLACK * 2)
+		return NULL;
+	size += RAM_SLACK * 2;
+#ifdef RAM_MMAP
+	ram = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(ram == MAP_FAILED) return NULL;
+#else
+	if(!(ram = (Uint8 *)calloc(size, sizeof(Uint8)))) return NULL;
+#endif
+	return ram + RAM_SLACK;
+}
+
+void
+system_ram_free(Uint8 *ram)
+{
+	if(!ram) return;
+#ifdef RAM_MMAP
+	munmap(ram - RAM_SLACK, (size_t)ram_pages * PAGE_SIZE + RAM_SLACK * 2);
+#else
+	free(ram - RAM_SLACK);
+#endif
+}
+
+/* The number of banks is checked as given, before it is narrowed. */
+
+int
+system_banks(char *arg)
+{
+	unsigned long banks = strtoul(arg, NULL, 0);
+	if(banks < 1 || banks > RAM_PAGES_MAX) return 0;
+	ram_pages = banks;
+	return 1;
+}
 
 int
 system_error(char *msg, const char *err)
@@ -48,88 +168,266 @@ system_error(char *msg, const char *err)
 	return 0;
 }
 
+/* Ram is given zeroed, so until a first snapshot or restore the pages
+written since are the ones that hold anything. */
+
+static int
+system_pages(Uxn *u)
+{
+	if(!u->dirty) u->dirty = calloc(ram_pages << 8, sizeof(Uint8));
+	return !!u->dirty;
+}
+
 int
-system_boot(Uint8 *ram, char *rom_path, int has_args)
+system_init(Uxn *u, Uint8 *ram, char *rom_path, int has_args)
 {
-	uxn.ram = ram;
-	boot_path = rom_path;
-	uxn.dev[0x17] = has_args;
-	if(ram && system_load(uxn.ram + PAGE_PROGRAM, rom_path))
-		return uxn_eval(PAGE_PROGRAM);
+	u->ram = ram;
+	u->boot_path = rom_path;
+	u->dev[0x17] = has_args;
+	if(ram && system_pages(u) && system_load(u, rom_path)) {
+		uxn_invalidate(u, 0, PAGE_SIZE);
+		return 1;
+	}
 	return 0;
 }
 
 int
-system_reboot(int soft)
+system_boot(Uxn *u, Uint8 *ram, char *rom_path, int has_args)
+{
+	if(system_init(u, ram, rom_path, has_args))
+		return uxn_eval(u, PAGE_PROGRAM) || u->suspended;
+	return 0;
+}
+
+/* Reboots from a snapshot taken before the reset vector, a soft reboot
+keeps the zero-page. */
+
+int
+system_reboot(Uxn *u, UxnSnapshot *s, int soft)
+{
+	Uint8 zero[0x100];
+	if(soft) memcpy(zero, u->ram, 0x100);
+	if(!system_restore(u, s)) return 0;
+	if(soft) memcpy(u->ram, zero, 0x100), system_written(u, 0, 0, 0x100);
+	u->dev[0x17] = 0;
+	return uxn_eval(u, PAGE_PROGRAM) || u->suspended;
+}
+
+/* Snapshots and restores only copy the 256-byte pages written since the
+machine was last in step with the snapshot, a fresh machine differing from
+it in the pages the snapshot holds. A machine snapshots into the same
+UxnSnapshot each time. Device state kept in the machine comes along, open
+files and core caches do not. */
+
+int
+system_snapshot(Uxn *u, UxnSnapshot *s)
+{
+	unsigned int i;
+	if(!system_pages(u) || (!s->ram && !(s->ram = system_ram())) || (!s->held && !(s->held = calloc(ram_pages << 8, sizeof(Uint8)))))
+		return system_error("Snapshot", "Out of memory.");
+	for(i = 0; i < ram_pages << 8; i++)
+		if(u->dirty[i]) {
+			memcpy(s->ram + ((size_t)i << 8), u->ram + ((size_t)i << 8), 0x100);
+			s->held[i] = 1, u->dirty[i] = 0;
+		}
+	s->u = *u;
+	return 1;
+}
+
+int
+system_restore(Uxn *u, UxnSnapshot *s)
+{
+	unsigned int i;
+	Uxn m;
+	if(!s->ram) return 0;
+	if(!u->dirty) {
+		if(!system_pages(u)) return 0;
+		memcpy(u->dirty, s->held, ram_pages << 8);
+	}
+	for(i = 0; i < ram_pages << 8; i++) {
+		if(!u->dirty[i]) continue;
+		memcpy(u->ram + ((size_t)i << 8), s->ram + ((size_t)i << 8), 0x100);
+		if(i < 0x100) uxn_invalidate(u, i << 8, 0x100);
+		u->dirty[i] = 0;
+	}
+	m = *u, *u = s->u;
+	u->ram = m.ram, u->dirty = m.dirty, u->file = m.file, u->core = m.core;
+	return 1;
+}
+
+void
+system_written(Uxn *u, unsigned int bank, unsigned int addr, unsigned int len)
+{
+	unsigned int p, last = (addr + len - 1) >> 8;
+	if(!len) return;
+	if(!bank) uxn_invalidate(u, addr, len);
+	for(p = addr >> 8; p <= last; p++)
+		u->dirty[bank << 8 | (p & 0xff)] = 1;
+}
+
+/* A vector that ran out of budget carries on from where it stopped, other
+vectors are skipped until it ends. */
+
+int
+system_resume(Uxn *u)
 {
-	int i;
-	for(i = 0x0; i < 0x100; i++) uxn.dev[i] = 0;
-	for(i = soft ? 0x100 : 0; i < PAGE_SIZE; i++) uxn.ram[i] = 0;
-	uxn.wst.ptr = uxn.rst.ptr = 0;
-	return system_boot(uxn.ram, boot_path, 0);
+	Uint16 pc = u->suspended;
+	u->suspended = 0;
+	return uxn_eval(u, pc);
+}
+
+/* Expansion commands address a bank with a short, running past its end
+wraps to its start, so transfers are split where either side wraps and
+each span is done in bulk. Copies keep the byte by byte result of the
+original loops where spans overlap. */
+
+static unsigned int
+system_span(unsigned int a, unsigned int b, unsigned int length)
+{
+	unsigned int n = PAGE_SIZE - (a & PAGE_MASK), m = PAGE_SIZE - (b & PAGE_MASK);
+	if(m < n) n = m;
+	return n < length ? n : length;
+}
+
+static void
+system_fill(Uint8 *ram, unsigned int bank, unsigned int addr, Uint8 value, unsigned int length)
+{
+	unsigned int n;
+	for(; length; addr += n, length -= n) {
+		n = system_span(addr, addr, length);
+		memset(ram + PAGE_INDEX(bank, addr), value, n);
+	}
+}
+
+static void
+system_copy(Uint8 *ram, unsigned int src_bank, unsigned int src_addr, unsigned int dst_bank, unsigned int dst_addr, unsigned int length, int backward)
+{
+	unsigned int i, n, s, d;
+	Uint8 *src, *dst;
+	while(length) {
+		if(backward) {
+			s = ((src_addr + length - 1) & PAGE_MASK) + 1, d = ((dst_addr + length - 1) & PAGE_MASK) + 1;
+			n = s < d ? s : d;
+			n = n < length ? n : length;
+			src = ram + PAGE_INDEX(src_bank, src_addr + length - n);
+			dst = ram + PAGE_INDEX(dst_bank, dst_addr + length - n);
+			if(dst < src && dst + n > src)
+				for(i = n; i--; dst[i] = src[i]);
+			else
+				memmove(dst, src, n);
+		} else {
+			n = system_span(src_addr, dst_addr, length);
+			src = ram + PAGE_INDEX(src_bank, src_addr);
+			dst = ram + PAGE_INDEX(dst_bank, dst_addr);
+			if(dst > src && dst < src + n)
+				for(i = 0; i < n; i++) dst[i] = src[i];
+			else
+				memmove(dst, src, n);
+			src_addr += n, dst_addr += n;
+		}
+		length -= n;
+	}
+}
+
+/* Compare gives the length of the common prefix, search the offset of the
+first byte equal to the value, both give the length when there is none. */
+
+static unsigned int
+system_compare(Uint8 *ram, unsigned int a_bank, unsigned int a_addr, unsigned int b_bank, unsigned int b_addr, unsigned int length)
+{
+	unsigned int n, done = 0;
+	Uint8 *a, *b;
+	for(; done < length; done += n) {
+		n = system_span(a_addr + done, b_addr + done, length - done);
+		a = ram + PAGE_INDEX(a_bank, a_addr + done), b = ram + PAGE_INDEX(b_bank, b_addr + done);
+		if(memcmp(a, b, n)) {
+			while(*a++ == *b++) done++;
+			return done;
+		}
+	}
+	return length;
+}
+
+static unsigned int
+system_search(Uint8 *ram, unsigned int bank, unsigned int addr, Uint8 value, unsigned int length)
+{
+	unsigned int n, done = 0;
+	Uint8 *p, *hit;
+	for(; done < length; done += n) {
+		n = system_span(addr + done, addr + done, length - done);
+		p = ram + PAGE_INDEX(bank, addr + done);
+		if((hit = memchr(p, value, n)))
+			return done + (hit - p);
+	}
+	return length;
+}
+
+static void
+system_result(Uxn *u, Uint16 addr, Uint16 value)
+{
+	u->ram[addr] = value >> 8, u->ram[(Uint16)(addr + 1)] = value;
+	system_written(u, 0, addr, 2);
 }
 
 /* IO */
 
 Uint8
-system_dei(Uint8 addr)
+system_dei(Uxn *u, Uint8 addr)
 {
 	switch(addr) {
-	case 0x4: return uxn.wst.ptr;
-	case 0x5: return uxn.rst.ptr;
-	default: return uxn.dev[addr];
+	case 0x4: return u->wst.ptr;
+	case 0x5: return u->rst.ptr;
+	default: return u->dev[addr];
 	}
 }
 
 void
-system_deo(Uint8 port)
+system_deo(Uxn *u, Uint8 port)
 {
 	switch(port) {
+	case 0x1:
+		/* System/vector, which no emulator here acts on, holds the budget */
+		u->budget = PEEK2(u->dev) << 8;
+		if(u->budget_max && (!u->budget || u->budget > u->budget_max))
+			u->budget = u->budget_max;
+		break;
 	case 0x3: {
-		Uint16 addr = PEEK2(uxn.dev + 2);
-		Uint8 *aptr = uxn.ram + addr;
+		Uint16 addr = PEEK2(u->dev + 2);
+		Uint8 *aptr = u->ram + addr;
 		Uint16 length = PEEK2(aptr + 1);
-		if(uxn.ram[addr] == 0x0) {
-			unsigned int src_bank = PEEK2(aptr + 3);
-			unsigned int src_addr = PEEK2(aptr + 5);
-			Uint16 value = uxn.ram[addr + 7];
-			if(src_bank < RAM_PAGES) {
-				unsigned int a = src_addr;
-				unsigned int b = a + length;
-				for(; a < b; uxn.ram[PAGE_INDEX(src_bank, a++)] = value);
-			}
-		} else if(uxn.ram[addr] == 0x1) {
-			unsigned int src_bank = PEEK2(aptr + 3);
-			unsigned int src_addr = PEEK2(aptr + 5);
-			unsigned int dst_bank = PEEK2(aptr + 7);
-			unsigned int dst_addr = PEEK2(aptr + 9);
-			if(src_bank < RAM_PAGES && dst_bank < RAM_PAGES) {
-				unsigned int src_last = src_addr + length;
-				for(; src_addr < src_last; uxn.ram[PAGE_INDEX(dst_bank, dst_addr++)] = uxn.ram[PAGE_INDEX(src_bank, src_addr++)]);
+		unsigned int src_bank = PEEK2(aptr + 3);
+		unsigned int src_addr = PEEK2(aptr + 5);
+		unsigned int dst_bank = PEEK2(aptr + 7);
+		unsigned int dst_addr = PEEK2(aptr + 9);
+		if(u->ram[addr] == 0x0) {
+			if(src_bank < ram_pages) {
+				system_fill(u->ram, src_bank, src_addr, u->ram[addr + 7], length);
+				system_written(u, src_bank, src_addr, length);
 			}
-		} else if(uxn.ram[addr] == 0x2) {
-			unsigned int src_bank = PEEK2(aptr + 3);
-			unsigned int src_addr = PEEK2(aptr + 5);
-			unsigned int dst_bank = PEEK2(aptr + 7);
-			unsigned int dst_addr = PEEK2(aptr + 9);
-			if(src_bank < RAM_PAGES && dst_bank < RAM_PAGES) {
-				unsigned int src_last = src_addr + length;
-				unsigned int dst_last = dst_addr + length;
-				for(; src_last > src_addr; uxn.ram[PAGE_INDEX(dst_bank, --dst_last)] = uxn.ram[PAGE_INDEX(src_bank, --src_last)]);
+		} else if(u->ram[addr] == 0x1 || u->ram[addr] == 0x2) {
+			if(src_bank < ram_pages && dst_bank < ram_pages) {
+				system_written(u, dst_bank, dst_addr, length);
+				system_copy(u->ram, src_bank, src_addr, dst_bank, dst_addr, length, u->ram[addr] == 0x2);
 			}
+		} else if(u->ram[addr] == 0x3) {
+			if(src_bank < ram_pages && dst_bank < ram_pages)
+				system_result(u, addr + 11, system_compare(u->ram, src_bank, src_addr, dst_bank, dst_addr, length));
+		} else if(u->ram[addr] == 0x4) {
+			if(src_bank < ram_pages)
+				system_result(u, addr + 8, system_search(u->ram, src_bank, src_addr, u->ram[addr + 7], length));
 		} else
-			fprintf(stderr, "Unknown Expansion Command 0x%02x\n", uxn.ram[addr]);
+			fprintf(stderr, "Unknown Expansion Command 0x%02x\n", u->ram[addr]);
 		break;
 	}
 	case 0x4:
-		uxn.wst.ptr = uxn.dev[4];
+		u->wst.ptr = u->dev[4];
 		break;
 	case 0x5:
-		uxn.rst.ptr = uxn.dev[5];
+		u->rst.ptr = u->dev[5];
 		break;
 	case 0xe:
-		system_print("WST", &uxn.wst);
-		system_print("RST", &uxn.rst);
+		system_print("WST", &u->wst);
+		system_print("RST", &u->rst);
 		break;
 	}
 }
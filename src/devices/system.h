@@ -10,10 +10,26 @@ WITH REGARD TO THIS SOFTWARE.
 */
 
 #define RAM_PAGES 0x10
+#define RAM_PAGES_MAX 0x10000
+
+typedef struct UxnSnapshot {
+	Uxn u;
+	Uint8 *ram, *held;
+} UxnSnapshot;
+
+extern unsigned int ram_pages;
 
 int system_error(char *msg, const char *err);
-int system_boot(Uint8 *ram, char *rom_path, int has_args);
-int system_reboot(int soft);
+int system_banks(char *arg);
+Uint8 *system_ram(void);
+void system_ram_free(Uint8 *ram);
+int system_init(Uxn *u, Uint8 *ram, char *rom_path, int has_args);
+int system_boot(Uxn *u, Uint8 *ram, char *rom_path, int has_args);
+int system_reboot(Uxn *u, UxnSnapshot *s, int soft);
+int system_resume(Uxn *u);
+int system_snapshot(Uxn *u, UxnSnapshot *s);
+int system_restore(Uxn *u, UxnSnapshot *s);
+void system_written(Uxn *u, unsigned int bank, unsigned int addr, unsigned int len);
 
-Uint8 system_dei(Uint8 addr);
-void system_deo(Uint8 addr);
+Uint8 system_dei(Uxn *u, Uint8 addr);
+void system_deo(Uxn *u, Uint8 addr);
@@ -0,0 +1,687 @@
+#define _DEFAULT_SOURCE
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef UXN_JIT
+#define UXN_JIT
+#endif
+#include "uxn.h"
+
+/*
+Copyright (c) 2025 Devine Lu Linvega, Andrew Alderwick
+
+Permission to use, copy, modify, and distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE.
+*/
+
+/*
+Basic-block translation of uxntal to x86-64. A block starts at a vector or
+jump target and runs until a jump, a BRK or a DEO. Only opcode bytes are
+baked into the native code, literals and immediates are read from ram when
+the block runs, so self-modifying literals do not invalidate anything.
+Stores to an opcode byte drop the blocks covering it and leave the block.
+Each machine has its own code buffer, translation state is per thread.
+
+Registers while a block runs:
+	rbx  u              r13  wst.ptr
+	rbp  jit->code      r14  rst.ptr
+	r12  u->ram         r15  copy of a stack pointer, for keep mode
+*/
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define JIT_SIZE 0x400000
+#define JIT_BLOCK 0x40
+#define JIT_SPAN (JIT_BLOCK * 3)
+#define JIT_RESERVE 0x4000
+#define JIT_BRK 0x10000
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+#define OFF_RAM ((int)offsetof(Uxn, ram))
+#define OFF_DIRTY ((int)offsetof(Uxn, dirty))
+#define OFF_DAT(s) ((int)offsetof(Uxn, s.dat))
+#define OFF_PTR(s) ((int)offsetof(Uxn, s.ptr))
+
+typedef unsigned int (*JitEnter)(Uxn *u, unsigned int pc, unsigned int *step);
+typedef void (*JitFn)(void);
+
+typedef struct {
+	Uint8 *buf, *ptr, *blocks, *next, *enter_at;
+	Uint8 *cache[0x10000], code[0x10000];
+	JitEnter enter;
+} Jit;
+
+static __thread Jit *jit;
+
+/* Encoder */
+
+static void
+b1(int v)
+{
+	*jit->ptr++ = v;
+}
+
+static void
+b4(unsigned int v)
+{
+	b1(v), b1(v >> 8), b1(v >> 16), b1(v >> 24);
+}
+
+static void
+b8(unsigned long v)
+{
+	b4(v), b4(v >> 32);
+}
+
+static void
+op(int w, int opc, int reg, int index, int base)
+{
+	b1(0x40 | w << 3 | (reg >> 3) << 2 | (index >> 3) << 1 | base >> 3);
+	if(opc > 0xff) b1(opc >> 8);
+	b1(opc);
+}
+
+/* opc reg, [base + index * scale + disp] */
+static void
+mem(int w, int opc, int reg, int base, int index, int scale, int disp)
+{
+	op(w, opc, reg, index < 0 ? 0 : index, base);
+	b1(0x80 | (reg & 7) << 3 | 4);
+	b1(scale << 6 | (index < 0 ? 4 : index & 7) << 3 | (base & 7));
+	b4(disp);
+}
+
+/* opc rm, reg */
+static void
+reg(int w, int opc, int r, int rm)
+{
+	op(w, opc, r, 0, rm);
+	b1(0xc0 | (r & 7) << 3 | (rm & 7));
+}
+
+static void
+imm(int r, unsigned int v)
+{
+	op(0, 0xb8 + (r & 7), 0, 0, r);
+	b4(v);
+}
+
+static void
+imm64(int r, unsigned long v)
+{
+	op(1, 0xb8 + (r & 7), 0, 0, r);
+	b8(v);
+}
+
+static Uint8 *
+jcc(int cc)
+{
+	b1(0x70 | cc), b1(0);
+	return jit->ptr;
+}
+
+static void
+land(Uint8 *from)
+{
+	from[-1] = jit->ptr - from;
+}
+
+static void
+call(JitFn fn)
+{
+	unsigned long v;
+	memcpy(&v, &fn, sizeof(v));
+	imm64(RAX, v);
+	reg(0, 0xff, 2, RAX);
+}
+
+/* clang-format off */
+
+#define MOVZX8 0x0fb6
+#define MOVSX8 0x0fbe
+#define ST8 0x88
+#define ST32 0x89
+#define LD32 0x8b
+#define ADD 0x01
+#define ORA 0x09
+#define AND 0x21
+#define SUB 0x29
+#define EOR 0x31
+#define CMP 0x39
+#define TST 0x85
+#define MUL 0x0faf
+#define CC_Z 0x4
+#define CC_NZ 0x5
+#define CC_A 0x7
+#define CC_B 0x2
+#define CC_BE 0x6
+
+#define INC8(r) reg(0, 0xfe, 0, r)
+#define DEC8(r) reg(0, 0xfe, 1, r)
+#define SHL(r, n) (reg(0, 0xc1, 4, r), b1(n))
+#define SHR(r, n) (reg(0, 0xc1, 5, r), b1(n))
+#define ANDI(r, n) (reg(0, 0x81, 4, r), b4(n))
+#define ADDI(r, n) (reg(0, 0x81, 0, r), b4(n))
+#define MOV(d, s) reg(0, ST32, s, d)
+#define RAM(o, r, a) mem(0, o, r, R12, a, 0, 0)
+
+/* clang-format on */
+
+/* Stacks: pops go through p, which is a copy of s in keep mode */
+
+static __thread int s, p, o, s_dat, o_dat, _2;
+
+static void
+pop1(int r)
+{
+	DEC8(p);
+	mem(0, MOVZX8, r, RBX, p, 0, s_dat);
+}
+
+static void
+pop2(int r)
+{
+	pop1(r), pop1(RDI);
+	SHL(RDI, 8);
+	reg(0, ORA, RDI, r);
+}
+
+static void
+popx(int r)
+{
+	if(_2) pop2(r); else pop1(r);
+}
+
+static void
+push1(int r)
+{
+	mem(0, ST8, r, RBX, s, 0, s_dat);
+	INC8(s);
+}
+
+static void
+pushx(int r)
+{
+	if(_2) {
+		MOV(RDI, r), SHR(RDI, 8);
+		push1(RDI);
+	}
+	push1(r);
+}
+
+static void
+rpush1(int r)
+{
+	mem(0, ST8, r, RBX, o, 0, o_dat);
+	INC8(o);
+}
+
+static void
+spill(void)
+{
+	mem(0, ST8, R13, RBX, -1, 0, OFF_PTR(wst));
+	mem(0, ST8, R14, RBX, -1, 0, OFF_PTR(rst));
+}
+
+static void
+reload(void)
+{
+	mem(0, MOVZX8, R13, RBX, -1, 0, OFF_PTR(wst));
+	mem(0, MOVZX8, R14, RBX, -1, 0, OFF_PTR(rst));
+}
+
+/* Leaving a block: eax holds the next pc, the step count is in the trampoline's frame */
+
+static void
+leave(int steps)
+{
+	mem(0, 0x81, 5, RSP, -1, 0, 0x10), b4(steps);
+	b1(0xe9), b4(jit->next - (jit->ptr + 4));
+}
+
+static void
+leave_to(unsigned int pc, int steps)
+{
+	imm(RAX, pc);
+	leave(steps);
+}
+
+/* eax = pc + a, relative jumps sign-extend a byte */
+
+static void
+jump(Uint16 pc, int steps)
+{
+	if(!_2) {
+		reg(0, MOVSX8, RAX, RAX);
+		ADDI(RAX, pc);
+	}
+	ANDI(RAX, 0xffff);
+	leave(steps);
+}
+
+static void
+literal(int r, Uint16 addr)
+{
+	mem(0, MOVZX8, r, R12, -1, 0, addr);
+}
+
+/* eax = pc + 2 + immediate short at pc */
+
+static void
+jump_imm(Uint16 pc, int steps)
+{
+	literal(RAX, pc), SHL(RAX, 8);
+	literal(RCX, pc + 1);
+	reg(0, ORA, RCX, RAX);
+	ADDI(RAX, pc + 2);
+	ANDI(RAX, 0xffff);
+	leave(steps);
+}
+
+/* Memory: address in eax, the second byte of a short wraps by mask m */
+
+static void
+peek(int m)
+{
+	RAM(MOVZX8, RCX, RAX);
+	push1(RCX);
+	if(_2) {
+		if(m == 0xff)
+			INC8(RAX);
+		else
+			reg(0, 0xff, 0, RAX), ANDI(RAX, 0xffff);
+		RAM(MOVZX8, RCX, RAX);
+		push1(RCX);
+	}
+}
+
+static void
+written(Uxn *u, unsigned int a, unsigned int b)
+{
+	uxn_invalidate(u, a, 1);
+	if(b != a) uxn_invalidate(u, b, 1);
+}
+
+static void
+poke(int m, Uint16 next, int steps)
+{
+	Uint8 *ok;
+	popx(RDX);
+	MOV(RSI, RAX);
+	if(_2) {
+		reg(0, 0xff, 0, RSI);
+		ANDI(RSI, m);
+		RAM(ST8, RDX, RSI);
+		SHR(RDX, 8);
+	}
+	RAM(ST8, RDX, RAX);
+	mem(1, LD32, RCX, RBX, -1, 0, OFF_DIRTY);
+	MOV(RDX, RAX), SHR(RDX, 8);
+	mem(0, 0xc6, 0, RCX, RDX, 0, 0), b1(1); /* mov byte [rcx + rdx], 1 */
+	if(_2) {
+		MOV(RDX, RSI), SHR(RDX, 8);
+		mem(0, 0xc6, 0, RCX, RDX, 0, 0), b1(1);
+	}
+	mem(0, MOVZX8, RCX, RBP, RAX, 0, 0);
+	mem(0, 0x0a, RCX, RBP, RSI, 0, 0); /* or cl, [rbp + rsi] */
+	reg(0, 0x84, RCX, RCX);            /* test cl, cl */
+	ok = jcc(CC_Z);
+	MOV(RDX, RSI), MOV(RSI, RAX);
+	reg(1, ST32, RBX, RDI);
+	call((JitFn)written);
+	leave_to(next, steps);
+	land(ok);
+}
+
+static void
+device_in(void)
+{
+	pop1(RAX);
+	spill();
+	mem(0, ST32, RAX, RSP, -1, 0, 0x8);
+	reg(0, MOVZX8, RSI, RAX);
+	reg(1, ST32, RBX, RDI);
+	call((JitFn)emu_dei);
+	if(_2) {
+		mem(0, ST8, RAX, RSP, -1, 0, 0xc);
+		mem(0, LD32, RSI, RSP, -1, 0, 0x8);
+		INC8(RSI);
+		reg(0, MOVZX8, RSI, RSI);
+		reg(1, ST32, RBX, RDI);
+		call((JitFn)emu_dei);
+		MOV(RCX, RAX);
+		mem(0, MOVZX8, RAX, RSP, -1, 0, 0xc);
+	}
+	reload();
+	push1(RAX);
+	if(_2) push1(RCX);
+}
+
+static void
+device_out(Uint16 next, int steps)
+{
+	pop1(RAX);
+	popx(RDX);
+	spill();
+	mem(0, ST32, RAX, RSP, -1, 0, 0x8);
+	mem(0, ST32, RDX, RSP, -1, 0, 0xc);
+	reg(0, MOVZX8, RSI, RAX);
+	if(_2) SHR(RDX, 8);
+	reg(0, MOVZX8, RDX, RDX);
+	reg(1, ST32, RBX, RDI);
+	call((JitFn)emu_deo);
+	if(_2) {
+		mem(0, LD32, RSI, RSP, -1, 0, 0x8);
+		INC8(RSI);
+		reg(0, MOVZX8, RSI, RSI);
+		mem(0, MOVZX8, RDX, RSP, -1, 0, 0xc);
+		reg(1, ST32, RBX, RDI);
+		call((JitFn)emu_deo);
+	}
+	reload();
+	leave_to(next, steps);
+}
+
+static void
+compare(int cc)
+{
+	popx(RAX), popx(RCX);
+	reg(0, CMP, RAX, RCX);
+	reg(0, 0x0f90 | cc, 0, RAX);
+	reg(0, MOVZX8, RAX, RAX);
+	push1(RAX);
+}
+
+static void
+arith(int opc)
+{
+	popx(RAX), popx(RCX);
+	if(opc == MUL)
+		reg(0, MUL, RCX, RAX);
+	else
+		reg(0, opc, RAX, RCX);
+	pushx(RCX);
+}
+
+/* Translate one instruction, returns non-zero when it ends the block */
+
+static int
+translate(Uint8 ins, Uint16 pc, int steps)
+{
+	Uint8 *skip, *done;
+	int k = ins & 0x80, r = ins & 0x40;
+	_2 = !!(ins & 0x20);
+	s = r ? R14 : R13, o = r ? R13 : R14;
+	s_dat = r ? OFF_DAT(rst) : OFF_DAT(wst);
+	o_dat = r ? OFF_DAT(wst) : OFF_DAT(rst);
+	p = s;
+	if(!(ins & 0x1f)) {
+		switch(ins) {
+		case 0x00: /* BRK */ leave_to(JIT_BRK, steps); return 1;
+		case 0x20: /* JCI */
+			DEC8(R13);
+			mem(0, 0x80, 7, RBX, R13, 0, OFF_DAT(wst)), b1(0);
+			skip = jcc(CC_Z);
+			jump_imm(pc, steps);
+			land(skip);
+			return 0;
+		case 0x40: /* JMI */ jump_imm(pc, steps); return 1;
+		case 0x60: /* JSI */
+			imm(RCX, (pc + 2) >> 8), push1(RCX);
+			imm(RCX, (pc + 2) & 0xff), push1(RCX);
+			jump_imm(pc, steps);
+			return 1;
+		default: /* LIT */
+			literal(RAX, pc), push1(RAX);
+			if(_2) literal(RAX, pc + 1), push1(RAX);
+			return 0;
+		}
+	}
+	if(k) {
+		MOV(R15, s);
+		p = R15;
+	}
+	switch(ins & 0x1f) {
+	case 0x01: /* INC */ popx(RAX), reg(0, 0xff, 0, RAX), pushx(RAX); break;
+	case 0x02: /* POP */ DEC8(p); if(_2) DEC8(p); break;
+	case 0x03: /* NIP */ popx(RAX), DEC8(p); if(_2) DEC8(p); pushx(RAX); break;
+	case 0x04: /* SWP */ popx(RAX), popx(RCX), pushx(RAX), pushx(RCX); break;
+	case 0x05: /* ROT */ popx(RAX), popx(RCX), popx(RDX), pushx(RCX), pushx(RAX), pushx(RDX); break;
+	case 0x06: /* DUP */ popx(RAX), pushx(RAX), pushx(RAX); break;
+	case 0x07: /* OVR */ popx(RAX), popx(RCX), pushx(RCX), pushx(RAX), pushx(RCX); break;
+	case 0x08: /* EQU */ compare(CC_Z); break;
+	case 0x09: /* NEQ */ compare(CC_NZ); break;
+	case 0x0a: /* GTH */ compare(CC_A); break;
+	case 0x0b: /* LTH */ compare(CC_B); break;
+	case 0x0c: /* JMP */ popx(RAX), jump(pc, steps); return 1;
+	case 0x0d: /* JCN */
+		popx(RAX), pop1(RCX);
+		reg(0, TST, RCX, RCX);
+		skip = jcc(CC_Z);
+		jump(pc, steps);
+		land(skip);
+		return 0;
+	case 0x0e: /* JSR */
+		popx(RAX);
+		imm(RCX, pc >> 8), rpush1(RCX);
+		imm(RCX, pc & 0xff), rpush1(RCX);
+		jump(pc, steps);
+		return 1;
+	case 0x0f: /* STH */
+		popx(RAX);
+		if(_2) MOV(RCX, RAX), SHR(RCX, 8), rpush1(RCX);
+		rpush1(RAX);
+		break;
+	case 0x10: /* LDZ */ pop1(RAX), peek(0xff); break;
+	case 0x11: /* STZ */ pop1(RAX), poke(0xff, pc, steps); break;
+	case 0x12: /* LDR */ pop1(RAX), reg(0, MOVSX8, RAX, RAX), ADDI(RAX, pc), ANDI(RAX, 0xffff), peek(0xffff); break;
+	case 0x13: /* STR */ pop1(RAX), reg(0, MOVSX8, RAX, RAX), ADDI(RAX, pc), ANDI(RAX, 0xffff), poke(0xffff, pc, steps); break;
+	case 0x14: /* LDA */ pop2(RAX), peek(0xffff); break;
+	case 0x15: /* STA */ pop2(RAX), poke(0xffff, pc, steps); break;
+	case 0x16: /* DEI */ device_in(); break;
+	case 0x17: /* DEO */ device_out(pc, steps); return 1;
+	case 0x18: /* ADD */ arith(ADD); break;
+	case 0x19: /* SUB */ arith(SUB); break;
+	case 0x1a: /* MUL */ arith(MUL); break;
+	case 0x1b: /* DIV */
+		popx(RSI), popx(RAX);
+		reg(0, TST, RSI, RSI);
+		skip = jcc(CC_NZ);
+		reg(0, EOR, RAX, RAX);
+		b1(0xeb), b1(0), done = jit->ptr;
+		land(skip);
+		reg(0, EOR, RDX, RDX);
+		reg(0, 0xf7, 6, RSI);
+		land(done);
+		pushx(RAX);
+		break;
+	case 0x1c: /* AND */ arith(AND); break;
+	case 0x1d: /* ORA */ arith(ORA); break;
+	case 0x1e: /* EOR */ arith(EOR); break;
+	case 0x1f: /* SFT */
+		pop1(RAX), popx(RDX);
+		MOV(RCX, RAX), ANDI(RCX, 0xf);
+		reg(0, 0xd3, 5, RDX);
+		MOV(RCX, RAX), SHR(RCX, 4);
+		reg(0, 0xd3, 4, RDX);
+		pushx(RDX);
+		break;
+	}
+	return 0;
+}
+
+static void
+jit_flush(void)
+{
+	memset(jit->cache, 0, sizeof(jit->cache));
+	memset(jit->code, 0, sizeof(jit->code));
+	jit->ptr = jit->blocks;
+}
+
+static Uint8 *
+jit_translate(Uxn *u, Uint16 pc)
+{
+	int steps;
+	Uint8 *start;
+	if(jit->ptr + JIT_RESERVE > jit->buf + JIT_SIZE)
+		jit_flush();
+	start = jit->ptr;
+	for(steps = 1;; steps++) {
+		Uint8 ins = u->ram[pc];
+		jit->code[pc++] = 1;
+		if(translate(ins, pc, steps))
+			break;
+		if(!(ins & 0x1f) && (ins & 0x80)) pc += 1 + !!(ins & 0x20);
+		else if(ins == 0x20) pc += 2;
+		if(steps == JIT_BLOCK) {
+			leave_to(pc, steps);
+			break;
+		}
+	}
+	return start;
+}
+
+/* Blocks chain through jit->next until one is missing from the cache, the
+trampoline sets up the registers and a frame for the step count. Running
+out of steps returns the next pc with the count zeroed. */
+
+static void
+jit_trampoline(void)
+{
+	Uint8 *stop, *out, *missing, *lookup;
+	jit->next = jit->ptr;
+	stop = jcc(CC_BE);
+	lookup = jit->ptr;
+	reg(0, 0x81, 7, RAX), b4(0xffff); /* cmp eax, 0xffff */
+	out = jcc(CC_A);
+	imm64(RCX, (unsigned long)jit->cache);
+	mem(1, LD32, RCX, RCX, RAX, 3, 0);
+	reg(1, TST, RCX, RCX);
+	missing = jcc(CC_Z);
+	reg(0, 0xff, 4, RCX);
+	land(stop);
+	mem(0, 0xc7, 0, RSP, -1, 0, 0x10), b4(0); /* mov dword [rsp+0x10], 0 */
+	land(out), land(missing);
+	b1(0xc3);
+	jit->enter_at = jit->ptr;
+	b1(0x53), b1(0x55);
+	b1(0x41), b1(0x54), b1(0x41), b1(0x55), b1(0x41), b1(0x56), b1(0x41), b1(0x57);
+	reg(1, 0x83, 5, RSP), b1(0x20); /* sub rsp, 0x20 */
+	reg(1, ST32, RDI, RBX);
+	mem(1, LD32, R12, RBX, -1, 0, OFF_RAM);
+	imm64(RBP, (unsigned long)jit->code);
+	reload();
+	mem(0, LD32, RCX, RDX, -1, 0, 0);
+	mem(0, ST32, RCX, RSP, -1, 0, 0x8);
+	mem(1, ST32, RDX, RSP, -1, 0, 0x10);
+	MOV(RAX, RSI);
+	b1(0xe8), b4(lookup - (jit->ptr + 4));
+	mem(1, LD32, RCX, RSP, -1, 0, 0x10);
+	mem(0, LD32, RDX, RSP, -1, 0, 0x8);
+	mem(0, ST32, RDX, RCX, -1, 0, 0);
+	spill();
+	reg(1, 0x83, 0, RSP), b1(0x20); /* add rsp, 0x20 */
+	b1(0x41), b1(0x5f), b1(0x41), b1(0x5e), b1(0x41), b1(0x5d), b1(0x41), b1(0x5c);
+	b1(0x5d), b1(0x5b), b1(0xc3);
+}
+
+static int
+jit_init(Uxn *u)
+{
+	void *buf = mmap(NULL, JIT_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(buf == MAP_FAILED)
+		return 0;
+	if(!(jit = calloc(1, sizeof(Jit)))) {
+		munmap(buf, JIT_SIZE);
+		return 0;
+	}
+	jit->ptr = jit->buf = buf;
+	jit_trampoline();
+	memcpy(&jit->enter, &jit->enter_at, sizeof(jit->enter));
+	jit->blocks = jit->ptr;
+	u->core = jit;
+	return 1;
+}
+
+void
+uxn_invalidate(Uxn *u, Uint16 addr, unsigned int len)
+{
+	unsigned int i, j;
+	Jit *m = u->core;
+	if(!m) return;
+	for(i = 0; i < len; i++, addr++) {
+		if(!m->code[addr]) continue;
+		m->code[addr] = 0;
+		for(j = 0; j < JIT_SPAN; j++)
+			m->cache[(Uint16)(addr - j)] = NULL;
+	}
+}
+
+void
+uxn_release(Uxn *u)
+{
+	Jit *m = u->core;
+	if(!m) return;
+	munmap(m->buf, JIT_SIZE);
+	free(m);
+	u->core = NULL;
+}
+
+int
+uxn_eval(Uxn *u, Uint16 pc)
+{
+	unsigned int next, step = u->budget ? u->budget : STEP_MAX;
+	if(!pc || u->dev[0x0f] || u->suspended) return 0;
+	if(!u->core && !jit_init(u))
+		return uxn_interpret(u, pc);
+	for(;;) {
+		jit = u->core;
+		if(!jit->cache[pc])
+			jit->cache[pc] = jit_translate(u, pc);
+		next = jit->enter(u, pc, &step);
+		if(next == JIT_BRK) return 1;
+		if(!step) {
+			u->suspended = next;
+			return 0;
+		}
+		pc = next;
+	}
+}
+
+#else
+
+void
+uxn_invalidate(Uxn *u, Uint16 addr, unsigned int len)
+{
+	(void)u, (void)addr, (void)len;
+}
+
+void
+uxn_release(Uxn *u)
+{
+	(void)u;
+}
+
+int
+uxn_eval(Uxn *u, Uint16 pc)
+{
+	return uxn_interpret(u, pc);
+}
+
+#endif
+
+#ifdef UXN_CORE
+UxnCore uxn_core = {UXN_NAME(UXN_CORE), uxn_eval, uxn_invalidate, uxn_release};
+#endif
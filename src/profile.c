@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef UXN_PROFILE
+#define UXN_PROFILE
+#endif
+#include "uxn.h"
+
+/*
+Copyright (c) 2025 Devine Lu Linvega
+
+Permission to use, copy, modify, and distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE.
+*/
+
+/* Profiler: the interpreter counts every fetch by opcode and by address,
+and every JSR/JSI by its target. The report charges each address to the
+nearest label at or below it, read from the .sym file next to the rom. */
+
+typedef struct {
+	Uint16 addr;
+	char *name;
+	unsigned long ins, calls;
+} Label;
+
+static char ops[][4] = {
+	"BRK", "INC", "POP", "NIP", "SWP", "ROT", "DUP", "OVR",
+	"EQU", "NEQ", "GTH", "LTH", "JMP", "JCN", "JSR", "STH",
+	"LDZ", "STZ", "LDR", "STR", "LDA", "STA", "DEI", "DEO",
+	"ADD", "SUB", "MUL", "DIV", "AND", "ORA", "EOR", "SFT"};
+
+static char *
+op_name(Uint8 op, char *buf)
+{
+	switch(op) {
+	case 0x20: return "JCI";
+	case 0x40: return "JMI";
+	case 0x60: return "JSI";
+	case 0x80: return "LIT";
+	case 0xa0: return "LIT2";
+	case 0xc0: return "LITr";
+	case 0xe0: return "LIT2r";
+	}
+	sprintf(buf, "%s%s%s%s", ops[op & 0x1f], op & 0x20 ? "2" : "", op & 0x80 ? "k" : "", op & 0x40 ? "r" : "");
+	return buf;
+}
+
+static int
+by_addr(const void *a, const void *b)
+{
+	return (int)((Label *)a)->addr - (int)((Label *)b)->addr;
+}
+
+static int
+by_ins(const void *a, const void *b)
+{
+	unsigned long x = ((Label *)a)->ins, y = ((Label *)b)->ins;
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* Reads name.sym into labels, the first of which catches anything below
+the lowest label. Returns the label count, or 0 on failure. */
+
+static int
+profile_symbols(char *rom_path, char **sym, Label **labels)
+{
+	FILE *f;
+	long i, len;
+	int n = 1;
+	char *path = malloc(strlen(rom_path) + 5);
+	*sym = NULL, *labels = NULL;
+	if(!path) return 0;
+	sprintf(path, "%s.sym", rom_path);
+	f = fopen(path, "rb");
+	free(path);
+	if(f && !fseek(f, 0, SEEK_END) && (len = ftell(f)) > 0 && (*sym = malloc(len + 1))) {
+		rewind(f);
+		len = fread(*sym, 1, len, f);
+		(*sym)[len] = 0;
+		for(i = 2; i < len; i += 3, n++)
+			while(i < len && (*sym)[i]) i++;
+	} else
+		len = 0;
+	if(f) fclose(f);
+	if(!(*labels = calloc(n, sizeof(Label)))) return 0;
+	(*labels)[0].name = "?";
+	for(i = 0, n = 1; i + 2 < len; n++) {
+		Label *l = &(*labels)[n];
+		l->addr = (Uint8)(*sym)[i] << 8 | (Uint8)(*sym)[i + 1];
+		l->name = *sym + i + 2;
+		i += strlen(l->name) + 3;
+	}
+	qsort(*labels + 1, n - 1, sizeof(Label), by_addr);
+	return n;
+}
+
+void
+uxn_profile(Uxn *u)
+{
+	UxnProfile *prof = u->core;
+	Label *labels, ranked[0x100];
+	char *sym, buf[8];
+	unsigned long total = 0;
+	int i, j, n, addr;
+	if(!prof) return;
+	for(i = 0; i < 0x100; i++)
+		total += prof->op[i];
+	if(!total || !(n = profile_symbols(u->boot_path, &sym, &labels))) return;
+	fprintf(stderr, "Profile: %lu instructions\n\n", total);
+	/* labels */
+	for(addr = 0, i = 0; addr < 0x10000; addr++) {
+		while(i + 1 < n && labels[i + 1].addr <= addr) i++;
+		labels[i].ins += prof->pc[addr], labels[i].calls += prof->call[addr];
+	}
+	qsort(labels, n, sizeof(Label), by_ins);
+	fprintf(stderr, "%14s %7s %10s  %s\n", "instructions", "%", "calls", "label");
+	for(i = 0; i < n && labels[i].ins; i++)
+		fprintf(stderr, "%14lu %6.2f%% %10lu  %s\n", labels[i].ins, labels[i].ins * 100.0 / total, labels[i].calls, labels[i].name);
+	/* opcodes */
+	for(i = 0; i < 0x100; i++)
+		ranked[i].addr = i, ranked[i].ins = prof->op[i];
+	qsort(ranked, 0x100, sizeof(Label), by_ins);
+	fprintf(stderr, "\n%14s %7s  %s\n", "instructions", "%", "opcode");
+	for(j = 0; j < 0x100 && ranked[j].ins; j++)
+		fprintf(stderr, "%14lu %6.2f%%  %s\n", ranked[j].ins, ranked[j].ins * 100.0 / total, op_name(ranked[j].addr, buf));
+	free(labels), free(sym);
+}
+
+void
+uxn_release(Uxn *u)
+{
+	free(u->core);
+	u->core = NULL;
+}
@@ -0,0 +1,87 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "uxn.h"
+#include "devices/screen.h"
+
+/*
+Copyright (c) 2025 Devine Lu Linvega, Andrew Alderwick
+
+Permission to use, copy, modify, and distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE.
+*/
+
+/* Draws sprites through the screen device in every combination of depth,
+flip and blend mode, on either layer in turn, and prints the sprites drawn
+per second of each as a JSON object per line. */
+
+static Uxn u;
+static Uint8 ram[0x10000 + 0x100];
+
+int
+emu_resize(int width, int height)
+{
+	(void)width, (void)height;
+	return 1;
+}
+
+static double
+bench_time(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static void
+bench_deo(Uint8 addr, Uint16 value)
+{
+	u.dev[addr - 1] = value >> 8, u.dev[addr] = value;
+	screen_deo(&u, addr);
+}
+
+/* Sprites are drawn along the screen one at a time, with the auto byte set
+to move x after each and repeat along y, as roms draw tiles. */
+
+static double
+bench_sprites(int ctrl, long sprites)
+{
+	long i;
+	double start = bench_time();
+	u.dev[0x26] = 0x01, screen_deo(&u, 0x26);
+	for(i = 0; i < sprites; i++) {
+		if(!(i & 0x3f)) bench_deo(0x29, 0), bench_deo(0x2b, (i >> 6) * 8 % uxn_screen.height);
+		bench_deo(0x2d, (i & 0xff) << 4);
+		u.dev[0x2f] = ctrl | (i & 0x40), screen_deo(&u, 0x2f);
+	}
+	return bench_time() - start;
+}
+
+int
+main(int argc, char **argv)
+{
+	int i, ctrl;
+	long sprites = argc > 1 ? atol(argv[1]) : 200000;
+	double ms;
+	if(argc > 1 && argv[1][0] == '-')
+		return !fprintf(stdout, "usage: %s [sprites]\n", argv[0]);
+	u.ram = ram;
+	for(i = 0; i < 0x10000; i++) ram[i] = rand();
+	for(i = 0x8; i < 0xe; i++) u.dev[i] = rand();
+	screen_resize(64 * 8, 40 * 8, 1);
+	screen_palette(&u);
+	for(ctrl = 0; ctrl < 0x100; ctrl++) {
+		if(ctrl & 0x40) continue;
+		ms = bench_sprites(ctrl, sprites);
+		fprintf(stdout, "{\"bpp\": %d, \"flipx\": %d, \"flipy\": %d, \"blend\": %d, \"sprites\": %ld, \"sprites_per_second\": %.0f}\n",
+			ctrl & 0x80 ? 2 : 1, !!(ctrl & 0x10), !!(ctrl & 0x20), ctrl & 0xf, sprites, ms > 0 ? sprites / ms * 1e3 : 0);
+	}
+	return 0;
+}
@@ -1,3 +1,5 @@
+#include <stdlib.h>
+
 #include "uxn.h"
 
 /*
@@ -11,23 +13,277 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
-#define OPC(opc, init, body) {\
-	case 0x00|opc: {const int _2=0,_r=0;init body;} break;\
-	case 0x20|opc: {const int _2=1,_r=0;init body;} break;\
-	case 0x40|opc: {const int _2=0,_r=1;init body;} break;\
-	case 0x60|opc: {const int _2=1,_r=1;init body;} break;\
-	case 0x80|opc: {const int _2=0,_r=0,k=uxn.wst.ptr;init uxn.wst.ptr=k;body;} break;\
-	case 0xa0|opc: {const int _2=1,_r=0,k=uxn.wst.ptr;init uxn.wst.ptr=k;body;} break;\
-	case 0xc0|opc: {const int _2=0,_r=1,k=uxn.rst.ptr;init uxn.rst.ptr=k;body;} break;\
-	case 0xe0|opc: {const int _2=1,_r=1,k=uxn.rst.ptr;init uxn.rst.ptr=k;body;} break;\
+/* With the jit, or a rom translated by uxn2c, this interpreter is what
+they fall back to. */
+
+#if defined(UXN_JIT) || defined(UXN_AOT)
+#undef uxn_eval
+#define uxn_eval uxn_interpret
+#endif
+
+#if defined(UXN_JIT) && defined(UXN_DECODE)
+#error "UXN_JIT and UXN_DECODE are separate execution modes"
+#endif
+#if defined(UXN_PROFILE) && (defined(UXN_JIT) || defined(UXN_DECODE))
+#error "UXN_PROFILE counts in the plain interpreter only"
+#endif
+#if defined(UXN_TOS) && (defined(UXN_JIT) || defined(UXN_DECODE))
+#error "UXN_TOS caches the stack of the plain interpreter only"
+#endif
+
+/* Decode cache: each address is decoded once into a micro-op, fusing a
+literal with the instruction consuming it. A micro-op reads at most 4
+bytes, a store drops the ones reading it when its page holds any, and
+larger writes drop whole pages along with the page before. */
+
+/* With UXN_REGS, the stack pointers and the ram and page map pointers
+are kept in locals, so that byte stores do not force them to be reloaded.
+They are spilled to the machine around device calls and on the way out. */
+
+/* With UXN_TOS, the top byte of the working stack is kept in a local as
+well, its slot in the machine is stale until spilled. Pushing writes the
+old top back, popping reads the next one up, so an opcode taking two
+bytes and leaving one reads a single byte from the stack. A keep mode
+opcode puts the top back along with the pointer. Popped bytes are not
+written back, so above the pointer the stack may hold older bytes than
+the other cores leave there, which a rom only sees by underflowing all
+the way round or raising the pointer through System/wst. */
+
+#ifdef UXN_TOS
+#define TOS u->wst.dat[(Uint8)(PTR(wst) - 1)]
+#define TOS_SPILL TOS = tos;
+#define TOS_LOAD tos = TOS;
+#define KEEP_IN const Uint8 kt = tos;
+#define KEEP_OUT tos = kt;
+#else
+#define TOS_SPILL
+#define TOS_LOAD
+#define KEEP_IN
+#define KEEP_OUT
+#endif
+
+#ifdef UXN_REGS
+#define PTR(s) s##_ptr
+#define RAM ram
+#define PAGES pages
+#define SPILL TOS_SPILL u->wst.ptr = wst_ptr, u->rst.ptr = rst_ptr;
+#define RELOAD wst_ptr = u->wst.ptr, rst_ptr = u->rst.ptr; TOS_LOAD
+#else
+#define PTR(s) u->s.ptr
+#define RAM u->ram
+#define PAGES u->dirty
+#define SPILL TOS_SPILL
+#define RELOAD TOS_LOAD
+#endif
+
+/* Stores mark the pages they touch, for snapshots. */
+
+#define TOUCH(i) PAGES[(Uint16)(i) >> 8] = PAGES[(Uint16)((i) + 1) >> 8] = 1;
+
+#ifdef UXN_DECODE
+#define U_DEC 0x100
+#define U_LIT 0x101
+#define U_LIT2 0x102
+#define U_JCI 0x103
+#define U_JMI 0x104
+#define U_JSI 0x105
+#define U_ADD 0x106
+#define U_SUB 0x107
+#define U_AND 0x108
+#define U_EQU 0x109
+#define U_NEQ 0x10a
+#define U_GTH 0x10b
+#define U_LTH 0x10c
+#define U_SFT 0x10d
+#define U_LDZ 0x10e
+#define U_STZ 0x10f
+#define U_LDZ2 0x110
+#define U_STZ2 0x111
+#define U_DEI 0x112
+#define U_DEO 0x113
+#define U_DEI2 0x114
+#define U_DEO2 0x115
+#define U_JCN 0x116
+#define U_ADD2 0x117
+#define U_SUB2 0x118
+#define U_EQU2 0x119
+#define U_NEQ2 0x11a
+#define U_GTH2 0x11b
+#define U_LTH2 0x11c
+#define U_LDA 0x11d
+#define U_STA 0x11e
+#define U_LDA2 0x11f
+#define U_STA2 0x120
+#define U_JCN2 0x121
+#define U_JMP2 0x122
+#define U_JSR2 0x123
+#define U_END 0x124
+
+typedef struct {
+	Uint16 op, arg;
+} Uop;
+
+typedef struct {
+	Uop dec[0x10000];
+	Uint8 page[0x100];
+} Cache;
+
+static Uint16
+fuse(Uint8 ins)
+{
+	switch(ins) {
+	case 0x18: return U_ADD;
+	case 0x19: return U_SUB;
+	case 0x1c: return U_AND;
+	case 0x08: return U_EQU;
+	case 0x09: return U_NEQ;
+	case 0x0a: return U_GTH;
+	case 0x0b: return U_LTH;
+	case 0x1f: return U_SFT;
+	case 0x10: return U_LDZ;
+	case 0x11: return U_STZ;
+	case 0x30: return U_LDZ2;
+	case 0x31: return U_STZ2;
+	case 0x16: return U_DEI;
+	case 0x17: return U_DEO;
+	case 0x36: return U_DEI2;
+	case 0x37: return U_DEO2;
+	case 0x0d: return U_JCN;
+	default: return 0;
+	}
+}
+
+static Uint16
+fuse2(Uint8 ins)
+{
+	switch(ins) {
+	case 0x38: return U_ADD2;
+	case 0x39: return U_SUB2;
+	case 0x28: return U_EQU2;
+	case 0x29: return U_NEQ2;
+	case 0x2a: return U_GTH2;
+	case 0x2b: return U_LTH2;
+	case 0x14: return U_LDA;
+	case 0x15: return U_STA;
+	case 0x34: return U_LDA2;
+	case 0x35: return U_STA2;
+	case 0x2d: return U_JCN2;
+	case 0x2c: return U_JMP2;
+	case 0x2e: return U_JSR2;
+	default: return 0;
+	}
+}
+
+static void
+decode(Uxn *u, Cache *cache, Uint16 pc)
+{
+	Uop *o = &cache->dec[pc];
+	Uint8 *ram = u->ram, b = ram[(Uint16)(pc + 1)], c = ram[(Uint16)(pc + 2)], d = ram[(Uint16)(pc + 3)];
+	Uint16 op;
+	o->op = ram[pc], o->arg = 0;
+	switch(o->op) {
+	case 0x20: o->op = U_JCI, o->arg = pc + 3 + (b << 8 | c); break;
+	case 0x40: o->op = U_JMI, o->arg = pc + 3 + (b << 8 | c); break;
+	case 0x60: o->op = U_JSI, o->arg = pc + 3 + (b << 8 | c); break;
+	case 0x80:
+		op = fuse(c);
+		o->op = op ? op : U_LIT, o->arg = op == U_JCN ? pc + 3 + (Sint8)b : b;
+		break;
+	case 0xa0:
+		op = fuse2(d);
+		o->op = op ? op : U_LIT2, o->arg = b << 8 | c;
+		break;
+	}
+	cache->page[pc >> 8] = 1;
+}
+
+void
+uxn_invalidate(Uxn *u, Uint16 addr, unsigned int len)
+{
+	Cache *cache = u->core;
+	unsigned int i, n;
+	Uint8 p = (addr >> 8) - 1;
+	if(!cache || !len) return;
+	if(len < 0x100) {
+		for(i = 0; i < len + 3; i++) cache->dec[(Uint16)(addr - 3 + i)].op = U_DEC;
+		return;
+	}
+	/* the pages written wrap past 0xffff as the writes do */
+	if((n = (((addr & 0xff) + len - 1) >> 8) + 2) > 0x100) n = 0x100;
+	for(; n--; p++)
+		if(cache->page[p])
+			for(cache->page[p] = 0, i = 0; i < 0x100; i++) cache->dec[p << 8 | i].op = U_DEC;
+}
+
+void
+uxn_release(Uxn *u)
+{
+	free(u->core);
+	u->core = NULL;
+}
+
+#define FETCH dec[pc++].op
+#define OPS U_END
+#define DIRTY(i) { Uint16 d = (i); TOUCH(d) if(dec_page[(Uint16)(d - 3) >> 8] | dec_page[(Uint16)(d + 1) >> 8]) uxn_invalidate(u, d, 2); }
+#define ARG dec[pc - 1].arg
+#define W(o) u->wst.dat[(Uint8)(PTR(wst) + (o))]
+#define L2 W(0) = a >> 8; W(1) = a;
+#define T2 (unsigned int)(W(-2) << 8 | W(-1))
+#define S2(v) c = (v); W(-2) = c >> 8; W(-1) = c;
+#define CALL
+#elif defined(UXN_PROFILE)
+#define FETCH (prof->op[RAM[pc]]++, prof->pc[pc]++, RAM[pc++])
+#define OPS 0x100
+#define DIRTY(i) TOUCH(i)
+#define CALL prof->call[pc]++;
+#else
+#define FETCH RAM[pc++]
+#define OPS 0x100
+#define DIRTY(i) TOUCH(i)
+#define CALL
+#endif
+
+/* Dispatch: threaded code with labels-as-values, or a portable switch. */
+
+#if defined(__GNUC__) && !defined(UXN_SWITCH)
+#define UXN_THREADED
+#define CASE(c, l) l
+#define NEXT { if(--step) goto *table[FETCH]; goto suspend; }
+#define BEGIN { step = budget; goto *table[FETCH];
+#define END }
+#else
+#define CASE(c, l) case c
+#define NEXT break;
+#define BEGIN for(step = budget; step; step--) { switch(FETCH) {
+#define END } } goto suspend;
+#endif
+
+#define OPC(opc, name, init, body) {\
+	CASE(0x00|opc, _##name): {const int _2=0,_r=0;init body;} NEXT\
+	CASE(0x20|opc, _##name##2): {const int _2=1,_r=0;init body;} NEXT\
+	CASE(0x40|opc, _##name##r): {const int _2=0,_r=1;init body;} NEXT\
+	CASE(0x60|opc, _##name##2r): {const int _2=1,_r=1;init body;} NEXT\
+	CASE(0x80|opc, _##name##k): {const int _2=0,_r=0,k=PTR(wst);KEEP_IN init PTR(wst)=k;KEEP_OUT body;} NEXT\
+	CASE(0xa0|opc, _##name##2k): {const int _2=1,_r=0,k=PTR(wst);KEEP_IN init PTR(wst)=k;KEEP_OUT body;} NEXT\
+	CASE(0xc0|opc, _##name##kr): {const int _2=0,_r=1,k=PTR(rst);init PTR(rst)=k;body;} NEXT\
+	CASE(0xe0|opc, _##name##2kr): {const int _2=1,_r=1,k=PTR(rst);init PTR(rst)=k;body;} NEXT\
 }
 
 /* Microcode */
 
-#define JMI a = uxn.ram[pc] << 8 | uxn.ram[pc + 1], pc += a + 2;
-#define REM if(_r) uxn.rst.ptr -= 1 + _2; else uxn.wst.ptr -= 1 + _2;
-#define INC(s) uxn.s.dat[uxn.s.ptr++]
-#define DEC(s) uxn.s.dat[--uxn.s.ptr]
+#define JMI a = RAM[pc] << 8 | RAM[pc + 1], pc += a + 2;
+#define REM if(_r) PTR(rst) -= 1 + _2; else { PTR(wst) -= 1 + _2; TOS_LOAD }
+#ifdef UXN_TOS
+#define INC(s) INC_##s
+#define DEC(s) DEC_##s
+#define INC_wst *(TOS = tos, PTR(wst)++, &tos)
+#define DEC_wst (t = tos, PTR(wst)--, tos = TOS, t)
+#define INC_rst u->rst.dat[PTR(rst)++]
+#define DEC_rst u->rst.dat[--PTR(rst)]
+#else
+#define INC(s) u->s.dat[PTR(s)++]
+#define DEC(s) u->s.dat[--PTR(s)]
+#endif
 #define JMP(x) { if(_2) pc = x; else pc += (Sint8)x; }
 #define PO1(o) { o = _r ? DEC(rst) : DEC(wst);}
 #define PO2(o) { if(_r) o = DEC(rst), o |= DEC(rst) << 8; else o = DEC(wst), o |= DEC(wst) << 8; }
@@ -37,58 +293,161 @@ WITH REGARD TO THIS SOFTWARE.
 #define PUx(i) { if(_2) { c = (i); PU1(c >> 8) PU1(c) } else PU1(i) }
 #define GET(o) { if(_2) PO1(o[1]) PO1(o[0]) }
 #define PUT(i) { PU1(i[0]) if(_2) PU1(i[1]) }
-#define DEI(i,o) o[0] = emu_dei(i); if(_2) o[1] = emu_dei(i + 1); PUT(o)
-#define DEO(i,j) emu_deo(i, j[0]); if(_2) emu_deo(i + 1, j[1]);
-#define PEK(i,o,m) o[0] = uxn.ram[i]; if(_2) o[1] = uxn.ram[(i + 1) & m]; PUT(o)
-#define POK(i,j,m) uxn.ram[i] = j[0]; if(_2) uxn.ram[(i + 1) & m] = j[1];
+#define DEI(i,o) SPILL o[0] = emu_dei(u, i); if(_2) o[1] = emu_dei(u, i + 1); PUT(o)
+#define DEO(i,j) SPILL emu_deo(u, i, j[0]); if(_2) emu_deo(u, i + 1, j[1]); RELOAD
+#define PEK(i,o,m) o[0] = RAM[i]; if(_2) o[1] = RAM[(i + 1) & m]; PUT(o)
+#define POK(i,j,m) RAM[i] = j[0]; if(_2) RAM[(i + 1) & m] = j[1]; DIRTY(i)
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
 
 int
-uxn_eval(Uint16 pc)
+uxn_eval(Uxn *u, Uint16 pc)
 {
-	unsigned int a, b, c, x[2], y[2], z[2], step;
-	if(!pc || uxn.dev[0x0f]) return 0;
-	for(step = STEP_MAX; step; step--) {
-		switch(uxn.ram[pc++]) {
-		/* BRK */ case 0x00: return 1;
-		/* JCI */ case 0x20: if(DEC(wst)) { JMI break; } pc += 2; break;
-		/* JMI */ case 0x40: JMI break;
-		/* JSI */ case 0x60: c = pc + 2; INC(rst) = c >> 8; INC(rst) = c; JMI break;
-		/* LI2 */ case 0xa0: INC(wst) = uxn.ram[pc++]; /* fall-through */
-		/* LIT */ case 0x80: INC(wst) = uxn.ram[pc++]; break;
-		/* L2r */ case 0xe0: INC(rst) = uxn.ram[pc++]; /* fall-through */
-		/* LIr */ case 0xc0: INC(rst) = uxn.ram[pc++]; break;
-		/* INC */ OPC(0x01,POx(a),PUx(a + 1))
-		/* POP */ OPC(0x02,REM   ,{})
-		/* NIP */ OPC(0x03,GET(x) REM   ,PUT(x))
-		/* SWP */ OPC(0x04,GET(x) GET(y),PUT(x) PUT(y))
-		/* ROT */ OPC(0x05,GET(x) GET(y) GET(z),PUT(y) PUT(x) PUT(z))
-		/* DUP */ OPC(0x06,GET(x),PUT(x) PUT(x))
-		/* OVR */ OPC(0x07,GET(x) GET(y),PUT(y) PUT(x) PUT(y))
-		/* EQU */ OPC(0x08,POx(a) POx(b),PU1(b == a))
-		/* NEQ */ OPC(0x09,POx(a) POx(b),PU1(b != a))
-		/* GTH */ OPC(0x0a,POx(a) POx(b),PU1(b > a))
-		/* LTH */ OPC(0x0b,POx(a) POx(b),PU1(b < a))
-		/* JMP */ OPC(0x0c,POx(a),JMP(a))
-		/* JCN */ OPC(0x0d,POx(a) PO1(b),if(b) JMP(a))
-		/* JSR */ OPC(0x0e,POx(a),RP1(pc >> 8) RP1(pc) JMP(a))
-		/* STH */ OPC(0x0f,GET(x),RP1(x[0]) if(_2) RP1(x[1]))
-		/* LDZ */ OPC(0x10,PO1(a),PEK(a, x, 0xff))
-		/* STZ */ OPC(0x11,PO1(a) GET(y),POK(a, y, 0xff))
-		/* LDR */ OPC(0x12,PO1(a),PEK(pc + (Sint8)a, x, 0xffff))
-		/* STR */ OPC(0x13,PO1(a) GET(y),POK(pc + (Sint8)a, y, 0xffff))
-		/* LDA */ OPC(0x14,PO2(a),PEK(a, x, 0xffff))
-		/* STA */ OPC(0x15,PO2(a) GET(y),POK(a, y, 0xffff))
-		/* DEI */ OPC(0x16,PO1(a),DEI(a, x))
-		/* DEO */ OPC(0x17,PO1(a) GET(y),DEO(a, y))
-		/* ADD */ OPC(0x18,POx(a) POx(b),PUx(b + a))
-		/* SUB */ OPC(0x19,POx(a) POx(b),PUx(b - a))
-		/* MUL */ OPC(0x1a,POx(a) POx(b),PUx(b * a))
-		/* DIV */ OPC(0x1b,POx(a) POx(b),PUx(a ? b / a : 0))
-		/* AND */ OPC(0x1c,POx(a) POx(b),PUx(b & a))
-		/* ORA */ OPC(0x1d,POx(a) POx(b),PUx(b | a))
-		/* EOR */ OPC(0x1e,POx(a) POx(b),PUx(b ^ a))
-		/* SFT */ OPC(0x1f,PO1(a) POx(b),PUx(b >> (a & 0xf) << (a >> 4)))
-		}
+	unsigned int a, b, c, x[2], y[2], z[2], step, budget = u->budget ? u->budget : STEP_MAX;
+#ifdef UXN_DECODE
+	Cache *cache = u->core;
+	Uop *dec;
+	Uint8 *dec_page;
+#endif
+#ifdef UXN_PROFILE
+	UxnProfile *prof = u->core;
+#endif
+#ifdef UXN_REGS
+	Uint8 wst_ptr = u->wst.ptr, rst_ptr = u->rst.ptr, *ram = u->ram, *pages = u->dirty;
+#endif
+#ifdef UXN_TOS
+	Uint8 tos = u->wst.dat[(Uint8)(u->wst.ptr - 1)];
+	unsigned int t;
+#endif
+#ifdef UXN_THREADED
+	static void *table[OPS] = {
+		&&_BRK, &&_INC, &&_POP, &&_NIP, &&_SWP, &&_ROT, &&_DUP, &&_OVR, &&_EQU, &&_NEQ, &&_GTH, &&_LTH, &&_JMP, &&_JCN, &&_JSR, &&_STH,
+		&&_LDZ, &&_STZ, &&_LDR, &&_STR, &&_LDA, &&_STA, &&_DEI, &&_DEO, &&_ADD, &&_SUB, &&_MUL, &&_DIV, &&_AND, &&_ORA, &&_EOR, &&_SFT,
+		&&_JCI, &&_INC2, &&_POP2, &&_NIP2, &&_SWP2, &&_ROT2, &&_DUP2, &&_OVR2, &&_EQU2, &&_NEQ2, &&_GTH2, &&_LTH2, &&_JMP2, &&_JCN2, &&_JSR2, &&_STH2,
+		&&_LDZ2, &&_STZ2, &&_LDR2, &&_STR2, &&_LDA2, &&_STA2, &&_DEI2, &&_DEO2, &&_ADD2, &&_SUB2, &&_MUL2, &&_DIV2, &&_AND2, &&_ORA2, &&_EOR2, &&_SFT2,
+		&&_JMI, &&_INCr, &&_POPr, &&_NIPr, &&_SWPr, &&_ROTr, &&_DUPr, &&_OVRr, &&_EQUr, &&_NEQr, &&_GTHr, &&_LTHr, &&_JMPr, &&_JCNr, &&_JSRr, &&_STHr,
+		&&_LDZr, &&_STZr, &&_LDRr, &&_STRr, &&_LDAr, &&_STAr, &&_DEIr, &&_DEOr, &&_ADDr, &&_SUBr, &&_MULr, &&_DIVr, &&_ANDr, &&_ORAr, &&_EORr, &&_SFTr,
+		&&_JSI, &&_INC2r, &&_POP2r, &&_NIP2r, &&_SWP2r, &&_ROT2r, &&_DUP2r, &&_OVR2r, &&_EQU2r, &&_NEQ2r, &&_GTH2r, &&_LTH2r, &&_JMP2r, &&_JCN2r, &&_JSR2r, &&_STH2r,
+		&&_LDZ2r, &&_STZ2r, &&_LDR2r, &&_STR2r, &&_LDA2r, &&_STA2r, &&_DEI2r, &&_DEO2r, &&_ADD2r, &&_SUB2r, &&_MUL2r, &&_DIV2r, &&_AND2r, &&_ORA2r, &&_EOR2r, &&_SFT2r,
+		&&_LIT, &&_INCk, &&_POPk, &&_NIPk, &&_SWPk, &&_ROTk, &&_DUPk, &&_OVRk, &&_EQUk, &&_NEQk, &&_GTHk, &&_LTHk, &&_JMPk, &&_JCNk, &&_JSRk, &&_STHk,
+		&&_LDZk, &&_STZk, &&_LDRk, &&_STRk, &&_LDAk, &&_STAk, &&_DEIk, &&_DEOk, &&_ADDk, &&_SUBk, &&_MULk, &&_DIVk, &&_ANDk, &&_ORAk, &&_EORk, &&_SFTk,
+		&&_LIT2, &&_INC2k, &&_POP2k, &&_NIP2k, &&_SWP2k, &&_ROT2k, &&_DUP2k, &&_OVR2k, &&_EQU2k, &&_NEQ2k, &&_GTH2k, &&_LTH2k, &&_JMP2k, &&_JCN2k, &&_JSR2k, &&_STH2k,
+		&&_LDZ2k, &&_STZ2k, &&_LDR2k, &&_STR2k, &&_LDA2k, &&_STA2k, &&_DEI2k, &&_DEO2k, &&_ADD2k, &&_SUB2k, &&_MUL2k, &&_DIV2k, &&_AND2k, &&_ORA2k, &&_EOR2k, &&_SFT2k,
+		&&_LITr, &&_INCkr, &&_POPkr, &&_NIPkr, &&_SWPkr, &&_ROTkr, &&_DUPkr, &&_OVRkr, &&_EQUkr, &&_NEQkr, &&_GTHkr, &&_LTHkr, &&_JMPkr, &&_JCNkr, &&_JSRkr, &&_STHkr,
+		&&_LDZkr, &&_STZkr, &&_LDRkr, &&_STRkr, &&_LDAkr, &&_STAkr, &&_DEIkr, &&_DEOkr, &&_ADDkr, &&_SUBkr, &&_MULkr, &&_DIVkr, &&_ANDkr, &&_ORAkr, &&_EORkr, &&_SFTkr,
+		&&_LIT2r, &&_INC2kr, &&_POP2kr, &&_NIP2kr, &&_SWP2kr, &&_ROT2kr, &&_DUP2kr, &&_OVR2kr, &&_EQU2kr, &&_NEQ2kr, &&_GTH2kr, &&_LTH2kr, &&_JMP2kr, &&_JCN2kr, &&_JSR2kr, &&_STH2kr,
+		&&_LDZ2kr, &&_STZ2kr, &&_LDR2kr, &&_STR2kr, &&_LDA2kr, &&_STA2kr, &&_DEI2kr, &&_DEO2kr, &&_ADD2kr, &&_SUB2kr, &&_MUL2kr, &&_DIV2kr, &&_AND2kr, &&_ORA2kr, &&_EOR2kr, &&_SFT2kr,
+#ifdef UXN_DECODE
+		&&_DEC, &&_LITd, &&_LIT2d, &&_JCId, &&_JMId, &&_JSId, &&_ADDd, &&_SUBd, &&_ANDd, &&_EQUd, &&_NEQd, &&_GTHd, &&_LTHd, &&_SFTd, &&_LDZd, &&_STZd,
+		&&_LDZ2d, &&_STZ2d, &&_DEId, &&_DEOd, &&_DEI2d, &&_DEO2d, &&_JCNd, &&_ADD2d, &&_SUB2d, &&_EQU2d, &&_NEQ2d, &&_GTH2d, &&_LTH2d, &&_LDAd, &&_STAd, &&_LDA2d,
+		&&_STA2d, &&_JCN2d, &&_JMP2d, &&_JSR2d
+#endif
+	};
+#endif
+	if(!pc || u->dev[0x0f] || u->suspended) return 0;
+#ifdef UXN_DECODE
+	if(!cache) {
+		if(!(cache = u->core = malloc(sizeof(Cache)))) return 0;
+		for(a = 0; a < 0x10000; a++) cache->dec[a].op = U_DEC;
+		for(a = 0; a < 0x100; a++) cache->page[a] = 0;
 	}
+	dec = cache->dec, dec_page = cache->page;
+#endif
+#ifdef UXN_PROFILE
+	if(!prof && !(prof = u->core = calloc(1, sizeof(UxnProfile)))) return 0;
+#endif
+	BEGIN
+		CASE(0x00, _BRK): SPILL return 1;
+		CASE(0x20, _JCI): if(DEC(wst)) { JMI NEXT } pc += 2; NEXT
+		CASE(0x40, _JMI): JMI NEXT
+		CASE(0x60, _JSI): c = pc + 2; INC(rst) = c >> 8; INC(rst) = c; JMI CALL NEXT
+		CASE(0x80, _LIT): INC(wst) = RAM[pc++]; NEXT
+		CASE(0xa0, _LIT2): INC(wst) = RAM[pc++]; INC(wst) = RAM[pc++]; NEXT
+		CASE(0xc0, _LITr): INC(rst) = RAM[pc++]; NEXT
+		CASE(0xe0, _LIT2r): INC(rst) = RAM[pc++]; INC(rst) = RAM[pc++]; NEXT
+		OPC(0x01,INC,POx(a),PUx(a + 1))
+		OPC(0x02,POP,REM   ,{})
+		OPC(0x03,NIP,GET(x) REM   ,PUT(x))
+		OPC(0x04,SWP,GET(x) GET(y),PUT(x) PUT(y))
+		OPC(0x05,ROT,GET(x) GET(y) GET(z),PUT(y) PUT(x) PUT(z))
+		OPC(0x06,DUP,GET(x),PUT(x) PUT(x))
+		OPC(0x07,OVR,GET(x) GET(y),PUT(y) PUT(x) PUT(y))
+		OPC(0x08,EQU,POx(a) POx(b),PU1(b == a))
+		OPC(0x09,NEQ,POx(a) POx(b),PU1(b != a))
+		OPC(0x0a,GTH,POx(a) POx(b),PU1(b > a))
+		OPC(0x0b,LTH,POx(a) POx(b),PU1(b < a))
+		OPC(0x0c,JMP,POx(a),JMP(a))
+		OPC(0x0d,JCN,POx(a) PO1(b),if(b) JMP(a))
+		OPC(0x0e,JSR,POx(a),RP1(pc >> 8) RP1(pc) JMP(a) CALL)
+		OPC(0x0f,STH,GET(x),RP1(x[0]) if(_2) RP1(x[1]))
+		OPC(0x10,LDZ,PO1(a),PEK(a, x, 0xff))
+		OPC(0x11,STZ,PO1(a) GET(y),POK(a, y, 0xff))
+		OPC(0x12,LDR,PO1(a),PEK(((pc + (Sint8)a) & 0xffff), x, 0xffff))
+		OPC(0x13,STR,PO1(a) GET(y),POK(((pc + (Sint8)a) & 0xffff), y, 0xffff))
+		OPC(0x14,LDA,PO2(a),PEK(a, x, 0xffff))
+		OPC(0x15,STA,PO2(a) GET(y),POK(a, y, 0xffff))
+		OPC(0x16,DEI,PO1(a),DEI(a, x))
+		OPC(0x17,DEO,PO1(a) GET(y),DEO(a, y))
+		OPC(0x18,ADD,POx(a) POx(b),PUx(b + a))
+		OPC(0x19,SUB,POx(a) POx(b),PUx(b - a))
+		OPC(0x1a,MUL,POx(a) POx(b),PUx(b * a))
+		OPC(0x1b,DIV,POx(a) POx(b),PUx(a ? b / a : 0))
+		OPC(0x1c,AND,POx(a) POx(b),PUx(b & a))
+		OPC(0x1d,ORA,POx(a) POx(b),PUx(b | a))
+		OPC(0x1e,EOR,POx(a) POx(b),PUx(b ^ a))
+		OPC(0x1f,SFT,PO1(a) POx(b),PUx(b >> (a & 0xf) << (a >> 4)))
+#ifdef UXN_DECODE
+		CASE(U_DEC, _DEC): decode(u, cache, --pc); NEXT
+		CASE(U_LIT, _LITd): W(0) = ARG; PTR(wst)++; pc++; NEXT
+		CASE(U_LIT2, _LIT2d): a = ARG; L2 PTR(wst) += 2; pc += 2; NEXT
+		CASE(U_JCI, _JCId): if(DEC(wst)) { pc = ARG; NEXT } pc += 2; NEXT
+		CASE(U_JMI, _JMId): pc = ARG; NEXT
+		CASE(U_JSI, _JSId): c = pc + 2; INC(rst) = c >> 8; INC(rst) = c; pc = ARG; NEXT
+		CASE(U_ADD, _ADDd): a = ARG; W(0) = a; W(-1) += a; pc += 2; NEXT
+		CASE(U_SUB, _SUBd): a = ARG; W(0) = a; W(-1) -= a; pc += 2; NEXT
+		CASE(U_AND, _ANDd): a = ARG; W(0) = a; W(-1) &= a; pc += 2; NEXT
+		CASE(U_EQU, _EQUd): a = ARG; W(0) = a; W(-1) = W(-1) == a; pc += 2; NEXT
+		CASE(U_NEQ, _NEQd): a = ARG; W(0) = a; W(-1) = W(-1) != a; pc += 2; NEXT
+		CASE(U_GTH, _GTHd): a = ARG; W(0) = a; W(-1) = W(-1) > a; pc += 2; NEXT
+		CASE(U_LTH, _LTHd): a = ARG; W(0) = a; W(-1) = W(-1) < a; pc += 2; NEXT
+		CASE(U_SFT, _SFTd): a = ARG; W(0) = a; W(-1) = W(-1) >> (a & 0xf) << (a >> 4); pc += 2; NEXT
+		CASE(U_LDZ, _LDZd): W(0) = RAM[ARG]; PTR(wst)++; pc += 2; NEXT
+		CASE(U_STZ, _STZd): a = ARG; W(0) = a; RAM[a] = DEC(wst); DIRTY(a) pc += 2; NEXT
+		CASE(U_LDZ2, _LDZ2d): a = ARG; W(0) = RAM[a]; W(1) = RAM[(a + 1) & 0xff]; PTR(wst) += 2; pc += 2; NEXT
+		CASE(U_STZ2, _STZ2d): a = ARG; W(0) = a; RAM[a] = W(-2); RAM[(a + 1) & 0xff] = W(-1); PTR(wst) -= 2; DIRTY(a) pc += 2; NEXT
+		CASE(U_DEI, _DEId): a = ARG; SPILL W(0) = emu_dei(u, a); PTR(wst)++; pc += 2; NEXT
+		CASE(U_DEO, _DEOd): a = ARG; W(0) = a; b = DEC(wst); pc += 2; SPILL emu_deo(u, a, b); RELOAD NEXT
+		CASE(U_DEI2, _DEI2d): a = ARG; SPILL x[0] = emu_dei(u, a); x[1] = emu_dei(u, a + 1); W(0) = x[0]; W(1) = x[1]; PTR(wst) += 2; pc += 2; NEXT
+		CASE(U_DEO2, _DEO2d): a = ARG; W(0) = a; x[0] = W(-2); x[1] = W(-1); PTR(wst) -= 2; pc += 2; SPILL emu_deo(u, a, x[0]); emu_deo(u, a + 1, x[1]); RELOAD NEXT
+		CASE(U_JCN, _JCNd): a = ARG; W(0) = RAM[pc]; pc += 2; if(DEC(wst)) pc = a; NEXT
+		CASE(U_ADD2, _ADD2d): a = ARG; L2 S2(T2 + a) pc += 3; NEXT
+		CASE(U_SUB2, _SUB2d): a = ARG; L2 S2(T2 - a) pc += 3; NEXT
+		CASE(U_EQU2, _EQU2d): a = ARG; L2 W(-2) = T2 == a; PTR(wst)--; pc += 3; NEXT
+		CASE(U_NEQ2, _NEQ2d): a = ARG; L2 W(-2) = T2 != a; PTR(wst)--; pc += 3; NEXT
+		CASE(U_GTH2, _GTH2d): a = ARG; L2 W(-2) = T2 > a; PTR(wst)--; pc += 3; NEXT
+		CASE(U_LTH2, _LTH2d): a = ARG; L2 W(-2) = T2 < a; PTR(wst)--; pc += 3; NEXT
+		CASE(U_LDA, _LDAd): a = ARG; L2 W(0) = RAM[a]; PTR(wst)++; pc += 3; NEXT
+		CASE(U_STA, _STAd): a = ARG; L2 RAM[a] = DEC(wst); DIRTY(a) pc += 3; NEXT
+		CASE(U_LDA2, _LDA2d): a = ARG; W(0) = RAM[a]; W(1) = RAM[(a + 1) & 0xffff]; PTR(wst) += 2; pc += 3; NEXT
+		CASE(U_STA2, _STA2d): a = ARG; L2 RAM[a] = W(-2); RAM[(a + 1) & 0xffff] = W(-1); PTR(wst) -= 2; DIRTY(a) pc += 3; NEXT
+		CASE(U_JCN2, _JCN2d): a = ARG; L2 pc += 3; if(DEC(wst)) pc = a; NEXT
+		CASE(U_JMP2, _JMP2d): a = ARG; L2 pc = a; NEXT
+		CASE(U_JSR2, _JSR2d): a = ARG; L2 c = pc + 3; INC(rst) = c >> 8; INC(rst) = c; pc = a; NEXT
+#endif
+	END
+suspend:
+	SPILL
+	u->suspended = pc;
 	return 0;
 }
+
+#pragma GCC diagnostic pop
+
+#if defined(UXN_CORE) && !defined(UXN_JIT) && !defined(UXN_AOT)
+#ifdef UXN_DECODE
+UxnCore uxn_core = {UXN_NAME(UXN_CORE), uxn_eval, uxn_invalidate, uxn_release};
+#else
+UxnCore uxn_core = {UXN_NAME(UXN_CORE), uxn_eval, NULL, NULL};
+#endif
+#endif
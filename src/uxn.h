@@ -33,11 +33,81 @@ typedef struct {
 
 typedef struct Uxn {
 	Uint8 *ram, dev[0x100];
+	/* one byte per 256 bytes of ram, set when written since the last snapshot */
+	Uint8 *dirty;
 	Stack wst, rst;
+	/* instructions per vector before it is suspended, 0 for STEP_MAX, and
+	the one given on the command line, which a rom may only lower */
+	Uint32 budget, budget_max;
+	Uint16 suspended;
+	/* device state, private to each machine, but for the screen and audio
+	devices whose state is one per process */
+	char *boot_path;
+	int console_vector, mouse_vector, controller_vector;
+	int rX, rY, rA, rMX, rMY, rMA, rML, rDX, rDY;
+	struct UxnFile *file;
+	void *core;
 } Uxn;
 
-extern Uint8 emu_dei(Uint8 addr);
-extern void emu_deo( Uint8 addr, Uint8 value);
-extern Uxn uxn;
+extern Uint8 emu_dei(Uxn *u, Uint8 addr);
+extern void emu_deo(Uxn *u, Uint8 addr, Uint8 value);
 
-int uxn_eval(Uint16 pc);
+/* Cores: to link several into one binary, each is compiled with UXN_CORE
+set to its name, which suffixes its entry points and exports them as
+uxn_core_<name>. The rest is compiled with UXN_CORES listing them as
+X(name), and calls the one picked with uxn_select. */
+
+typedef struct UxnCore {
+	char *name;
+	int (*eval)(Uxn *u, Uint16 pc);
+	void (*invalidate)(Uxn *u, Uint16 addr, unsigned int len);
+	void (*release)(Uxn *u);
+} UxnCore;
+
+#if defined(UXN_CORES) && defined(UXN_PROFILE)
+#error "UXN_PROFILE is a build of its own"
+#endif
+
+#ifdef UXN_CORE
+#define UXN_CAT(a, b) a##_##b
+#define UXN_SYM(a, b) UXN_CAT(a, b)
+#define UXN_STR(a) #a
+#define UXN_NAME(a) UXN_STR(a)
+#define uxn_core UXN_SYM(uxn_core, UXN_CORE)
+#define uxn_eval UXN_SYM(uxn_eval, UXN_CORE)
+#define uxn_interpret UXN_SYM(uxn_interpret, UXN_CORE)
+#define uxn_invalidate UXN_SYM(uxn_invalidate, UXN_CORE)
+#define uxn_release UXN_SYM(uxn_release, UXN_CORE)
+extern UxnCore uxn_core;
+#endif
+
+int uxn_eval(Uxn *u, Uint16 pc);
+
+#ifdef UXN_CORES
+int uxn_select(char *name);
+#else
+#define uxn_select(name) ((void)(name), 0)
+#endif
+#if defined(UXN_JIT) || defined(UXN_AOT)
+int uxn_interpret(Uxn *u, Uint16 pc);
+#endif
+#if defined(UXN_JIT) || defined(UXN_DECODE) || defined(UXN_CORES)
+void uxn_invalidate(Uxn *u, Uint16 addr, unsigned int len);
+#elif !defined(UXN_CORE)
+#define uxn_invalidate(u, addr, len) ((void)0)
+#endif
+#if defined(UXN_JIT) || defined(UXN_DECODE) || defined(UXN_PROFILE) || defined(UXN_CORES)
+void uxn_release(Uxn *u);
+#elif !defined(UXN_CORE)
+#define uxn_release(u) ((void)0)
+#endif
+
+#ifdef UXN_PROFILE
+typedef struct {
+	unsigned long op[0x100], pc[0x10000], call[0x10000];
+} UxnProfile;
+
+void uxn_profile(Uxn *u);
+#else
+#define uxn_profile(u) ((void)0)
+#endif
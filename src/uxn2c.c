@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <string.h>
+
+/*
+Copyright (c) 2025 Devine Lu Linvega, Andrew Alderwick
+
+Permission to use, copy, modify, and distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE.
+*/
+
+/*
+Translates the code of a rom to a C core, ahead of time. Code is found by
+walking from the reset vector through JCI, JMI and JSI, the returns of
+calls, the targets of literal jumps, the vectors written to devices and
+the labels of the .sym file, which also name the blocks. A label on data
+is walked as code too, and only runs if something jumps there. Opcode bytes and immediate
+jumps are baked in, literals are read from ram as they run, so a rom may
+rewrite its literals but not its opcodes. Other jumps go through a switch
+on the address, or to the interpreter when the address is not one of ours.
+*/
+
+/* clang-format off */
+
+#define PAGE 0x0100
+#define error_top(id, msg) !fprintf(stderr, "%s: %s\n", id, msg)
+
+typedef unsigned char Uint8;
+typedef signed char Sint8;
+typedef unsigned short Uint16;
+
+static int length, work_len;
+static Uint8 rom[0x10000], start[0x10000], label[0x10000];
+static Uint16 work[0x10000];
+static char *names[0x10000], dict[0x20000];
+
+static char ops[][4] = {
+	"LIT", "INC", "POP", "NIP", "SWP", "ROT", "DUP", "OVR",
+	"EQU", "NEQ", "GTH", "LTH", "JMP", "JCN", "JSR", "STH",
+	"LDZ", "STZ", "LDR", "STR", "LDA", "STA", "DEI", "DEO",
+	"ADD", "SUB", "MUL", "DIV", "AND", "ORA", "EOR", "SFT"
+};
+
+/* What each opcode pops, before keep mode puts the pointer back, and
+what it does with it, as in uxn.c. Jumps are written out separately. */
+
+static char *init[] = {
+	"", "POx(a)", "REM", "GET(x) REM", "GET(x) GET(y)", "GET(x) GET(y) GET(z)", "GET(x)", "GET(x) GET(y)",
+	"POx(a) POx(b)", "POx(a) POx(b)", "POx(a) POx(b)", "POx(a) POx(b)", "POx(a)", "POx(a) PO1(b)", "POx(a)", "GET(x)",
+	"PO1(a)", "PO1(a) GET(y)", "PO1(a)", "PO1(a) GET(y)", "PO2(a)", "PO2(a) GET(y)", "PO1(a)", "PO1(a) GET(y)",
+	"POx(a) POx(b)", "POx(a) POx(b)", "POx(a) POx(b)", "POx(a) POx(b)", "POx(a) POx(b)", "POx(a) POx(b)", "POx(a) POx(b)", "PO1(a) POx(b)"
+};
+
+static char *body[] = {
+	"", "PUx(a + 1)", "", "PUT(x)", "PUT(x) PUT(y)", "PUT(y) PUT(x) PUT(z)", "PUT(x) PUT(x)", "PUT(y) PUT(x) PUT(y)",
+	"PU1(b == a)", "PU1(b != a)", "PU1(b > a)", "PU1(b < a)", "JMP(a)", "if(b) { JMP(a)", "RP1(pc >> 8) RP1(pc) JMP(a)", "RP1(x[0]) if(_2) RP1(x[1])",
+	"PEK(a, x, 0xff)", "POK(a, y, 0xff)", "PEK(((pc + (Sint8)a) & 0xffff), x, 0xffff)", "POK(((pc + (Sint8)a) & 0xffff), y, 0xffff)", "PEK(a, x, 0xffff)", "POK(a, y, 0xffff)", "DEI(a, x)", "DEO(a, y)",
+	"PUx(b + a)", "PUx(b - a)", "PUx(b * a)", "PUx(a ? b / a : 0)", "PUx(b & a)", "PUx(b | a)", "PUx(b ^ a)", "PUx(b >> (a & 0xf) << (a >> 4))"
+};
+
+static char *prelude[] = {
+	"#define PO1(o) { o = _r ? rs[--rp] : ws[--wp]; }\n",
+	"#define PO2(o) { if(_r) o = rs[--rp], o |= rs[--rp] << 8; else o = ws[--wp], o |= ws[--wp] << 8; }\n",
+	"#define POx(o) { if(_2) PO2(o) else PO1(o) }\n",
+	"#define PU1(i) { if(_r) rs[rp++] = i; else ws[wp++] = i; }\n",
+	"#define RP1(i) { if(_r) ws[wp++] = i; else rs[rp++] = i; }\n",
+	"#define PUx(i) { if(_2) { c = (i); PU1(c >> 8) PU1(c) } else PU1(i) }\n",
+	"#define GET(o) { if(_2) PO1(o[1]) PO1(o[0]) }\n",
+	"#define PUT(i) { PU1(i[0]) if(_2) PU1(i[1]) }\n",
+	"#define REM if(_r) rp -= 1 + _2; else wp -= 1 + _2;\n",
+	"#define JMP(x) { if(_2) pc = (x); else pc += (Sint8)(x); }\n",
+	"#define TOUCH(i) pages[(Uint16)(i) >> 8] = pages[(Uint16)((i) + 1) >> 8] = 1;\n",
+	"#define PEK(i,o,m) o[0] = ram[i]; if(_2) o[1] = ram[(i + 1) & m]; PUT(o)\n",
+	"#define POK(i,j,m) ram[i] = j[0]; if(_2) ram[(i + 1) & m] = j[1]; TOUCH(i)\n",
+	"#define SPILL u->wst.ptr = wp, u->rst.ptr = rp;\n",
+	"#define RELOAD wp = u->wst.ptr, rp = u->rst.ptr;\n",
+	"#define DEI(i,o) SPILL o[0] = emu_dei(u, i); if(_2) o[1] = emu_dei(u, i + 1); PUT(o)\n",
+	"#define DEO(i,j) SPILL emu_deo(u, i, j[0]); if(_2) emu_deo(u, i + 1, j[1]); RELOAD\n",
+	"#define STEP(n, at) if(step <= 0) { pc = at; goto suspend; } step -= n;\n"
+};
+
+/* clang-format on */
+
+static int
+width(Uint8 ins)
+{
+	switch(ins) {
+	case 0x20: case 0x40: case 0x60: case 0xa0: case 0xe0: return 3;
+	case 0x80: case 0xc0: return 2;
+	}
+	return 1;
+}
+
+static int
+ends(Uint8 ins)
+{
+	return !ins || ins == 0x40 || ins == 0x60 || (ins & 0x1f) == 0x0c || (ins & 0x1f) == 0x0e;
+}
+
+static int
+peek2(int addr)
+{
+	return rom[addr] << 8 | rom[addr + 1];
+}
+
+static void
+enqueue(int addr)
+{
+	addr &= 0xffff;
+	if(addr < PAGE || addr >= length) return;
+	label[addr] = 1;
+	if(!start[addr]) work[work_len++] = addr;
+}
+
+/* The target of a jump that follows a literal, if the literal is still
+the one in the rom when it runs. */
+
+static int
+guess(int addr, int prev)
+{
+	Uint8 ins = rom[addr];
+	if(ins & 0x40 || prev < 0) return -1;
+	if(ins & 0x20) return rom[prev] == 0xa0 && prev == addr - 3 ? peek2(prev + 1) : -1;
+	return rom[prev] == 0x80 && prev == addr - 2 ? (addr + 1 + (Sint8)rom[prev + 1]) & 0xffff : -1;
+}
+
+static void
+walk(void)
+{
+	while(work_len) {
+		int addr = work[--work_len], prev = -1, prev2 = -1;
+		while(addr >= PAGE && addr < length && !start[addr]) {
+			Uint8 ins = rom[addr];
+			int next = addr + width(ins), g = guess(addr, prev);
+			start[addr] = 1;
+			if(ins == 0x20 || ins == 0x40 || ins == 0x60) enqueue(next + peek2(addr + 1));
+			if(ins == 0x60 || (ins & 0x1f) == 0x0e) enqueue(next);
+			if(g >= 0 && ((ins & 0x1f) == 0x0c || (ins & 0x1f) == 0x0d || (ins & 0x1f) == 0x0e)) enqueue(g);
+			/* vectors, LIT2 addr LIT port DEO2 */
+			if(ins == 0x37 && prev == addr - 2 && rom[prev] == 0x80 && !(rom[prev + 1] & 0x0f) && prev2 == addr - 5 && rom[prev2] == 0xa0)
+				enqueue(peek2(prev2 + 1));
+			if(ends(ins)) break;
+			prev2 = prev, prev = addr, addr = next;
+		}
+	}
+}
+
+static void
+symbols(char *path)
+{
+	FILE *f;
+	int i, len;
+	char *d = dict;
+	if(!(f = fopen(path, "rb"))) return;
+	len = fread(dict, 1, sizeof(dict) - 1, f);
+	fclose(f);
+	for(i = 0; i + 2 < len;) {
+		int addr = (Uint8)d[i] << 8 | (Uint8)d[i + 1];
+		char *name = d + i + 2;
+		if(!names[addr] && !strstr(name, "*/")) names[addr] = name;
+		enqueue(addr);
+		i += strlen(name) + 3;
+	}
+}
+
+static void
+jump(FILE *o, int addr)
+{
+	if(start[addr & 0xffff])
+		fprintf(o, "goto L%04x;", addr & 0xffff);
+	else
+		fprintf(o, "{ pc = 0x%04x; goto dispatch; }", addr & 0xffff);
+}
+
+/* Instructions from a label until the next label or the end of the block. */
+
+static int
+steps(int addr)
+{
+	int n = 1;
+	for(;;) {
+		Uint8 ins = rom[addr];
+		int next = addr + width(ins);
+		if(ends(ins) || next >= length || !start[next] || label[next]) return n;
+		addr = next, n++;
+	}
+}
+
+static void
+emit(FILE *o, int addr)
+{
+	Uint8 ins = rom[addr];
+	int op = ins & 0x1f, next = addr + width(ins), g = -1, prev;
+	char *ptr = ins & 0x40 ? "rp" : "wp";
+	if(label[addr])
+		fprintf(o, "L%04x:%s%s%s\n\tSTEP(%d, 0x%04x)\n", addr, names[addr] ? " /* " : "", names[addr] ? names[addr] : "", names[addr] ? " */" : "", steps(addr), addr);
+	fprintf(o, "\t");
+	switch(ins) {
+	case 0x00: fprintf(o, "SPILL return 1; /* BRK */\n"); return;
+	case 0x20: fprintf(o, "if(ws[--wp]) "), jump(o, next + peek2(addr + 1)), fprintf(o, " /* JCI */\n"); break;
+	case 0x40: jump(o, next + peek2(addr + 1)), fprintf(o, " /* JMI */\n"); return;
+	case 0x60: fprintf(o, "rs[rp++] = 0x%02x; rs[rp++] = 0x%02x; ", next >> 8, next & 0xff), jump(o, next + peek2(addr + 1)), fprintf(o, " /* JSI */\n"); return;
+	case 0x80: fprintf(o, "ws[wp++] = ram[0x%04x]; /* LIT */\n", addr + 1); break;
+	case 0xa0: fprintf(o, "ws[wp++] = ram[0x%04x]; ws[wp++] = ram[0x%04x]; /* LIT2 */\n", addr + 1, addr + 2); break;
+	case 0xc0: fprintf(o, "rs[rp++] = ram[0x%04x]; /* LITr */\n", addr + 1); break;
+	case 0xe0: fprintf(o, "rs[rp++] = ram[0x%04x]; rs[rp++] = ram[0x%04x]; /* LIT2r */\n", addr + 1, addr + 2); break;
+	default:
+		for(prev = addr - 3; prev < addr && !(start[prev] && prev + width(rom[prev]) == addr); prev++);
+		if(op >= 0x0c && op <= 0x0e) g = guess(addr, prev < addr ? prev : -1);
+		fprintf(o, "{ enum { _2 = %d, _r = %d }; ", !!(ins & 0x20), !!(ins & 0x40));
+		if(op == 0x12 || op == 0x13 || (op >= 0x0c && op <= 0x0e)) fprintf(o, "pc = 0x%04x; ", next & 0xffff);
+		if(ins & 0x80) fprintf(o, "k = %s; %s %s = k; ", ptr, init[op], ptr);
+		else fprintf(o, "%s ", init[op]);
+		fprintf(o, "%s", body[op]);
+		if(op >= 0x0c && op <= 0x0e) {
+			if(g >= 0 && start[g]) fprintf(o, " if(pc == 0x%04x) goto L%04x;", g, g);
+			fprintf(o, " goto dispatch;%s", op == 0x0d ? " }" : "");
+		}
+		fprintf(o, " } /* %s%s%s%s */\n", ops[op], ins & 0x20 ? "2" : "", ins & 0x80 ? "k" : "", ins & 0x40 ? "r" : "");
+		if(ends(ins)) return;
+	}
+	for(prev = addr + 1; prev < length && !start[prev]; prev++);
+	if(prev != next)
+		fprintf(o, "\t"), jump(o, next), fprintf(o, "\n");
+}
+
+static int
+translate(char *rompath, char *cpath)
+{
+	FILE *f, *o;
+	int i;
+	char sympath[0x400];
+	if(!(f = fopen(rompath, "rb")))
+		return error_top("Input file invalid", rompath);
+	length = PAGE + fread(rom + PAGE, 1, 0x10000 - PAGE, f);
+	fclose(f);
+	enqueue(PAGE);
+	if(strlen(rompath) + 5 < sizeof(sympath))
+		sprintf(sympath, "%s.sym", rompath), symbols(sympath);
+	walk();
+	/* blocks falling into code that is not next are ended with a jump */
+	for(i = PAGE; i < length; i++) {
+		int next = i + width(rom[i]);
+		if(start[i] && !ends(rom[i]) && next < length && start[next]) {
+			int j = i + 1;
+			while(j < next && !start[j]) j++;
+			if(j != next) label[next] = 1;
+		}
+	}
+	if(!(o = fopen(cpath, "w")))
+		return error_top("Output file invalid", cpath);
+	fprintf(o, "/* Translated from %s by uxn2c. */\n\n#include <string.h>\n\n#include \"uxn.h\"\n\n", rompath);
+	fprintf(o, "static const Uint8 rom[0x%04x] = {", length - PAGE);
+	for(i = PAGE; i < length; i++)
+		fprintf(o, "%s0x%02x,", (i - PAGE) % 16 ? " " : "\n\t", rom[i]);
+	fprintf(o, "\n};\n\n/* machines holding another rom are interpreted */\n\nstatic Uint8 native, interpreted;\n\n");
+	for(i = 0; i < (int)(sizeof(prelude) / sizeof(*prelude)); i++)
+		fputs(prelude[i], o);
+	fputc('\n', o);
+	fprintf(o, "int\nuxn_eval(Uxn *u, Uint16 pc)\n{\n");
+	fprintf(o, "\tUint8 *ram = u->ram, *pages = u->dirty, *ws = u->wst.dat, *rs = u->rst.dat, wp = u->wst.ptr, rp = u->rst.ptr, k;\n");
+	fprintf(o, "\tunsigned int a, b, c, x[2], y[2], z[2];\n\tlong step = u->budget ? (long)u->budget : 0x7fffffffL;\n");
+	fprintf(o, "\tif(!pc || u->dev[0x0f] || u->suspended) return 0;\n");
+	fprintf(o, "\tif(!u->core) u->core = memcmp(ram + 0x%04x, rom, sizeof(rom)) ? &interpreted : &native;\n", PAGE);
+	fprintf(o, "\tif(u->core != &native) return uxn_interpret(u, pc);\n\t(void)pages, (void)k, (void)z;\n\tgoto dispatch;\n");
+	for(i = PAGE; i < length; i++)
+		if(start[i]) emit(o, i);
+	fprintf(o, "dispatch:\n\tswitch(pc) {\n");
+	for(i = PAGE; i < length; i++)
+		if(label[i] && start[i]) fprintf(o, "\tcase 0x%04x: goto L%04x;\n", i, i);
+	fprintf(o, "\t}\n\tSPILL\n\treturn uxn_interpret(u, pc);\nsuspend:\n\tSPILL\n\tu->suspended = pc;\n\treturn 0;\n}\n");
+	fprintf(o, "\n#ifdef UXN_CORE\nUxnCore uxn_core = {UXN_NAME(UXN_CORE), uxn_eval, NULL, NULL};\n#endif\n");
+	fclose(o);
+	return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	if(argc == 2 && !strcmp(argv[1], "-v")) return !printf("Uxn2c - Uxn to C Translator, 31 Jan 2025.\n");
+	if(argc != 3) return error_top("usage", "uxn2c [-v] input.rom output.c");
+	return !translate(argv[1], argv[2]);
+}
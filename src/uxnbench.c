@@ -0,0 +1,140 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "uxn.h"
+#include "devices/system.h"
+#include "devices/console.h"
+#include "devices/datetime.h"
+
+/*
+Copyright (c) 2025 Devine Lu Linvega, Andrew Alderwick
+
+Permission to use, copy, modify, and distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE.
+*/
+
+/* Headless benchmark: boots a rom several times on the core it was built
+with, or the one picked with -x, and prints the wall time of the runs as a JSON object. Console and
+screen output is hashed rather than printed, along with the stacks the rom
+leaves, so that cores can be checked against each other. Built with --profile, it prints the instruction count instead. */
+
+static Uint32 output;
+
+Uint8
+emu_dei(Uxn *u, Uint8 addr)
+{
+	switch(addr & 0xf0) {
+	case 0x00: return system_dei(u, addr);
+	case 0xc0: return datetime_dei(u, addr);
+	}
+	return u->dev[addr];
+}
+
+void
+emu_deo(Uxn *u, Uint8 addr, Uint8 value)
+{
+	u->dev[addr] = value;
+	switch(addr & 0xf0) {
+	case 0x00:
+		if(addr != 0x0e) system_deo(u, addr);
+		break;
+	case 0x10:
+		if(addr == 0x18 || addr == 0x19) output = output * 31 + value;
+		break;
+	case 0x20: output = output * 31 + value; break;
+	}
+}
+
+static double
+bench_time(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static void
+bench_stack(Stack *s)
+{
+	Uint8 i;
+	output = output * 31 + s->ptr;
+	for(i = 0; i != s->ptr; i++)
+		output = output * 31 + s->dat[i];
+}
+
+/* Each run starts from a fresh machine, and includes whatever the core
+does on first sight of the code, the rom is read outside of the timing. */
+
+static double
+bench_run(Uxn *u, char *rom_path)
+{
+	double start, ms;
+	Uint8 *ram = u->ram, *dirty = u->dirty;
+	uxn_release(u);
+	memset(u, 0, sizeof(Uxn)), memset(ram, 0, (size_t)ram_pages * PAGE_SIZE);
+	u->dirty = dirty, output = 0;
+	if(!system_init(u, ram, rom_path, 0))
+		return -1;
+	start = bench_time();
+	uxn_eval(u, PAGE_PROGRAM);
+	if(u->console_vector && !u->dev[0x0f])
+		console_input(u, EOF, CONSOLE_END);
+	ms = bench_time() - start;
+	bench_stack(&u->wst), bench_stack(&u->rst);
+	return ms;
+}
+
+int
+main(int argc, char **argv)
+{
+	int i = 1, n, runs = 10;
+	unsigned long ins = 0;
+	char *core = "uxn";
+	double ms, sum = 0, sq = 0, min = 0, max = 0, mean, var;
+	Uxn u = {0};
+	if(argc == 2 && argv[1][0] == '-' && argv[1][1] == 'v')
+		return !fprintf(stdout, "Uxn(bench) - Varvara Emulator, 31 Jan 2025.\n");
+	for(; i + 2 < argc && argv[i][0] == '-'; i += 2) {
+		if(!strcmp(argv[i], "-r"))
+			runs = atoi(argv[i + 1]) < 1 ? 1 : atoi(argv[i + 1]);
+		else if(!strcmp(argv[i], "-i"))
+			ins = strtoul(argv[i + 1], NULL, 0);
+		else if(!strcmp(argv[i], "-x")) {
+			if(!uxn_select(core = argv[i + 1]))
+				return !fprintf(stdout, "Unknown core %s.\n", core);
+		} else
+			break;
+	}
+	if(i >= argc)
+		return !fprintf(stdout, "usage: %s [-v] [-r runs] [-i instructions] [-x core] file.rom\n", argv[0]);
+	if(!(u.ram = system_ram()))
+		return !fprintf(stdout, "Could not allocate memory.\n");
+#ifdef UXN_PROFILE
+	if(bench_run(&u, argv[i]) < 0)
+		return !fprintf(stdout, "Could not load %s.\n", argv[i]);
+	for(n = 0; n < 0x100; n++)
+		ins += ((UxnProfile *)u.core)->op[n];
+	return !fprintf(stdout, "%lu\n", ins);
+#endif
+	for(n = 0; n < runs; n++) {
+		if((ms = bench_run(&u, argv[i])) < 0)
+			return !fprintf(stdout, "Could not load %s.\n", argv[i]);
+		if(!n || ms < min) min = ms;
+		if(!n || ms > max) max = ms;
+		sum += ms, sq += ms * ms;
+	}
+	mean = sum / runs, var = sq / runs - mean * mean;
+	fprintf(stdout, "{\"core\": \"%s\", \"rom\": \"%s\", \"runs\": %d, \"output\": \"%08x\", ", core, argv[i], runs, (unsigned int)output);
+	fprintf(stdout, "\"instructions\": %lu, \"mips\": %.2f, ", ins, mean > 0 ? ins / mean / 1e3 : 0);
+	fprintf(stdout, "\"wall_ms\": {\"mean\": %.3f, \"min\": %.3f, \"max\": %.3f, \"variance\": %.4f}}\n", mean, min, max, var < 0 ? 0 : var);
+	uxn_release(&u);
+	free(u.dirty), system_ram_free(u.ram);
+	return 0;
+}
@@ -1,5 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifndef __plan9__
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 #include "uxn.h"
 #include "devices/system.h"
@@ -18,44 +23,231 @@ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
 WITH REGARD TO THIS SOFTWARE.
 */
 
-Uxn uxn;
-int console_vector;
+/* With -n, instances run on a pool of threads and their console output
+is held back in memory, then printed in order once they have all ended. The
+rom is read once into a snapshot, each thread keeps one machine and restores
+it from there before every instance. */
+
+typedef struct {
+	char *data;
+	size_t len, cap;
+	int lost;
+} Output;
+
+typedef struct {
+	Output out, err;
+	int status;
+} Job;
+
+typedef struct {
+	Uxn u;
+	Job *job;
+} Worker;
+
+static Job *jobs;
+static UxnSnapshot boot;
+static int jobs_len, jobs_next, rom_arg, rom_argc;
+static char **rom_argv;
+static Uint32 budget;
+#ifndef __plan9__
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Output that cannot grow is dropped, and the instance is said to have lost
+some once printed. */
+
+static void
+output_put(Output *o, char *data, size_t len)
+{
+	char *grown;
+	size_t cap;
+	if(o->len + len > o->cap) {
+		for(cap = o->cap ? o->cap : 0x100; cap < o->len + len; cap *= 2);
+		if(!(grown = realloc(o->data, cap))) {
+			o->lost = 1;
+			return;
+		}
+		o->data = grown, o->cap = cap;
+	}
+	memcpy(o->data + o->len, data, len);
+	o->len += len;
+}
 
 Uint8
-emu_dei(Uint8 addr)
+emu_dei(Uxn *u, Uint8 addr)
 {
 	switch(addr & 0xf0) {
-	case 0x00: return system_dei(addr);
-	case 0xc0: return datetime_dei(addr);
+	case 0x00: return system_dei(u, addr);
+	case 0xc0: return datetime_dei(u, addr);
 	}
-	return uxn.dev[addr];
+	return u->dev[addr];
 }
 
 void
-emu_deo(Uint8 addr, Uint8 value)
+emu_deo(Uxn *u, Uint8 addr, Uint8 value)
 {
-	uxn.dev[addr] = value;
+	u->dev[addr] = value;
 	switch(addr & 0xf0) {
-	case 0x00: system_deo(addr); break;
-	case 0x10: console_deo(addr); break;
-	case 0xa0: file_deo(addr); break;
-	case 0xb0: file_deo(addr); break;
+	case 0x00: system_deo(u, addr); break;
+	case 0x10:
+		if(jobs && (addr == 0x18 || addr == 0x19))
+			output_put(addr == 0x18 ? &((Worker *)u)->job->out : &((Worker *)u)->job->err, (char *)&value, 1);
+		else
+			console_deo(u, addr);
+		break;
+	case 0xa0: file_deo(u, addr); break;
+	case 0xb0: file_deo(u, addr); break;
 	}
 }
 
+/* With -b, a vector running out of budget ends the rom. */
+
+static int
+budget_exceeded(Uxn *u, Output *o)
+{
+	char msg[0x40];
+	sprintf(msg, "Budget of %u instructions exceeded at #%04x.\n", (unsigned int)u->budget, u->suspended);
+	if(o)
+		output_put(o, msg, strlen(msg));
+	else
+		fputs(msg, stderr);
+	return 1;
+}
+
+static void
+job_run(Worker *w, Job *j)
+{
+	Uxn *u = &w->u;
+	w->job = j;
+	j->status = -1;
+	file_release(u);
+	if(!system_restore(u, &boot))
+		return;
+	uxn_eval(u, PAGE_PROGRAM);
+	if(u->console_vector && !u->suspended) {
+		console_arguments(u, rom_arg, rom_argc, rom_argv);
+		if(!u->dev[0x0f] && !u->suspended) console_input(u, EOF, CONSOLE_STD);
+	}
+	j->status = u->suspended ? budget_exceeded(u, &j->err) : u->dev[0x0f] & 0x7f;
+}
+
+static void *
+job_worker(void *arg)
+{
+	Worker w;
+	memset(&w, 0, sizeof(w));
+	if((w.u.ram = system_ram())) {
+		for(;;) {
+			int id;
+#ifndef __plan9__
+			pthread_mutex_lock(&jobs_lock);
+			id = jobs_next++;
+			pthread_mutex_unlock(&jobs_lock);
+#else
+			id = jobs_next++;
+#endif
+			if(id >= jobs_len) break;
+			job_run(&w, &jobs[id]);
+		}
+	}
+	uxn_release(&w.u);
+	file_release(&w.u);
+	free(w.u.dirty), system_ram_free(w.u.ram);
+	return arg;
+}
+
+static void
+job_print(Output *o, FILE *f, int id)
+{
+	fwrite(o->data, 1, o->len, f);
+	if(o->lost)
+		fprintf(stderr, "Output of instance %d was cut short.\n", id);
+	free(o->data);
+}
+
+static int
+jobs_run(void)
+{
+	int i, threads = 1, status = 0;
+	Uxn u = {0};
+#ifndef __plan9__
+	pthread_t *pool;
+#ifdef _SC_NPROCESSORS_ONLN
+	threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if(threads < 1) threads = 1;
+	if(threads > jobs_len) threads = jobs_len;
+#endif
+	u.budget = u.budget_max = budget;
+	if(!system_init(&u, system_ram(), rom_argv[rom_arg - 1], rom_argc > rom_arg) || !system_snapshot(&u, &boot))
+		return !fprintf(stdout, "Could not load %s.\n", rom_argv[rom_arg - 1]);
+	system_ram_free(u.ram), free(u.dirty);
+	if(!(jobs = (Job *)calloc(jobs_len, sizeof(Job))))
+		return !fprintf(stdout, "Could not allocate %d instances.\n", jobs_len);
+#ifndef __plan9__
+	pool = (pthread_t *)calloc(threads, sizeof(pthread_t));
+	for(i = 0; pool && i < threads - 1; i++)
+		if(pthread_create(&pool[i], NULL, job_worker, NULL)) break;
+	threads = pool ? i : 0;
+	job_worker(NULL);
+	for(i = 0; i < threads; i++)
+		pthread_join(pool[i], NULL);
+	free(pool);
+#else
+	job_worker(NULL);
+#endif
+	for(i = 0; i < jobs_len; i++) {
+		job_print(&jobs[i].out, stdout, i), job_print(&jobs[i].err, stderr, i);
+		if(jobs[i].status < 0)
+			fprintf(stdout, "Could not allocate instance %d.\n", i), status = 1;
+		else if(jobs[i].status > status)
+			status = jobs[i].status;
+	}
+	free(jobs), system_ram_free(boot.ram), free(boot.held);
+	return status;
+}
+
 int
 main(int argc, char **argv)
 {
-	int i = 1;
+	int i = 1, status;
+	Uxn u = {0};
 	if(argc == 2 && argv[1][0] == '-' && argv[1][1] == 'v')
 		return !fprintf(stdout, "Uxn(cli) - Varvara Emulator, 31 Jan 2025.\n");
-	else if(argc == 1)
-		return !fprintf(stdout, "usage: %s [-v] file.rom [args..]\n", argv[0]);
-	else if(!system_boot((Uint8 *)calloc(PAGE_SIZE * RAM_PAGES, sizeof(Uint8)), argv[i++], argc > 2))
-		return !fprintf(stdout, "Could not load %s.\n", argv[i - 1]);
-	if(console_vector) {
-		console_arguments(i, argc, argv);
-		while(!uxn.dev[0x0f] && console_input(fgetc(stdin), 0x1));
-	}
-	return uxn.dev[0x0f] & 0x7f;
+	for(; i + 2 < argc && argv[i][0] == '-'; i += 2) {
+		if(!strcmp(argv[i], "-n"))
+			jobs_len = atoi(argv[i + 1]) < 1 ? 1 : atoi(argv[i + 1]);
+		else if(!strcmp(argv[i], "-m")) {
+			if(!system_banks(argv[i + 1]))
+				return !fprintf(stdout, "Banks must be between 1 and %d.\n", RAM_PAGES_MAX);
+		} else if(!strcmp(argv[i], "-b"))
+			budget = strtoul(argv[i + 1], NULL, 0);
+		else if(!strcmp(argv[i], "-x")) {
+			if(!uxn_select(argv[i + 1]))
+				return !fprintf(stdout, "Unknown core %s.\n", argv[i + 1]);
+		} else
+			break;
+	}
+	if(i >= argc)
+		return !fprintf(stdout, "usage: %s [-v] [-n instances] [-m banks] [-b budget] [-x core] file.rom [args..]\n", argv[0]);
+	if(jobs_len) {
+		rom_arg = i + 1, rom_argc = argc, rom_argv = argv;
+		return jobs_run();
+	}
+	u.budget = u.budget_max = budget;
+	if(!system_boot(&u, system_ram(), argv[i], argc > i + 1))
+		status = !fprintf(stdout, "Could not load %s.\n", argv[i]);
+	else {
+		i++;
+		if(u.console_vector && !u.suspended) {
+			console_arguments(&u, i, argc, argv);
+			while(!u.dev[0x0f] && !u.suspended && console_input(&u, fgetc(stdin), 0x1));
+		}
+		uxn_profile(&u);
+		status = u.suspended ? budget_exceeded(&u, NULL) : u.dev[0x0f] & 0x7f;
+	}
+	uxn_release(&u);
+	file_release(&u);
+	free(u.dirty), system_ram_free(u.ram);
+	return status;
 }
@@ -44,8 +44,8 @@ WITH REGARD TO THIS SOFTWARE.
 #define HEIGHT 40 * 8
 #define TIMEOUT_MS 334
 
-Uxn uxn;
-int console_vector;
+static Uxn uxn;
+static UxnSnapshot boot;
 
 static SDL_Window *emu_window;
 static SDL_Texture *emu_texture;
@@ -60,6 +60,41 @@ static int window_created, fullscreen, borderless;
 static Uint32 stdin_event, audio0_event, zoom = 1;
 static Uint64 exec_deadline, deadline_interval, ms_interval;
 
+/* events held while a vector is suspended */
+
+#define HELD_MAX 0x400
+
+static SDL_Event held[HELD_MAX];
+static int held_len, held_next;
+
+/* input log */
+
+enum { IN_MOTION, IN_MOUSE_UP, IN_MOUSE_DOWN, IN_SCROLL, IN_KEY, IN_DOWN, IN_UP, IN_CONSOLE, IN_AUDIO, IN_HALT, IN_RESTART, IN_END };
+
+static FILE *in_record, *in_replay;
+static Uint8 in_next[10];
+static Uint32 frame;
+static int in_pending;
+
+/* frame pacing */
+
+#define SKIP_MAX 5
+
+static int fast_forward, frame_skip, fast_every = 8;
+static Uint32 drawn, rate_frame, rate_drawn;
+static Uint64 rate_time;
+
+/* frame timing */
+
+#define TIMED_FRAMES 600
+
+enum { T_EVENTS, T_VECTOR, T_UPLOAD, T_PRESENT, T_TOTAL };
+
+static char *timed_names[] = {"events", "vector", "upload", "present", "total"};
+static Uint64 timed[T_TOTAL];
+static Uint32 timed_us[TIMED_FRAMES][T_TOTAL + 1], timed_count;
+static FILE *timed_csv;
+
 static Uint8
 audio_dei(int instance, Uint8 *d, Uint8 port)
 {
@@ -72,53 +107,53 @@ audio_dei(int instance, Uint8 *d, Uint8 port)
 }
 
 static void
-audio_deo(int instance, Uint8 *d, Uint8 port)
+audio_deo(Uxn *u, int instance, Uint8 *d, Uint8 port)
 {
 	if(!audio_id) return;
 	if(port == 0xf) {
 		SDL_LockAudioDevice(audio_id);
-		audio_start(instance, d);
+		audio_start(instance, d, u->ram);
 		SDL_UnlockAudioDevice(audio_id);
 		SDL_PauseAudioDevice(audio_id, 0);
 	}
 }
 
 Uint8
-emu_dei(Uint8 addr)
+emu_dei(Uxn *u, Uint8 addr)
 {
 	Uint8 p = addr & 0x0f, d = addr & 0xf0;
 	switch(d) {
-	case 0x00: return system_dei(addr);
-	case 0x20: return screen_dei(addr);
-	case 0x30: return audio_dei(0, &uxn.dev[d], p);
-	case 0x40: return audio_dei(1, &uxn.dev[d], p);
-	case 0x50: return audio_dei(2, &uxn.dev[d], p);
-	case 0x60: return audio_dei(3, &uxn.dev[d], p);
-	case 0xc0: return datetime_dei(addr);
+	case 0x00: return system_dei(u, addr);
+	case 0x20: return screen_dei(u, addr);
+	case 0x30: return audio_dei(0, &u->dev[d], p);
+	case 0x40: return audio_dei(1, &u->dev[d], p);
+	case 0x50: return audio_dei(2, &u->dev[d], p);
+	case 0x60: return audio_dei(3, &u->dev[d], p);
+	case 0xc0: return datetime_dei(u, addr);
 	}
-	return uxn.dev[addr];
+	return u->dev[addr];
 }
 
 void
-emu_deo(Uint8 addr, Uint8 value)
+emu_deo(Uxn *u, Uint8 addr, Uint8 value)
 {
 	Uint8 p = addr & 0x0f, d = addr & 0xf0;
-	uxn.dev[addr] = value;
+	u->dev[addr] = value;
 	switch(d) {
 	case 0x00:
-		system_deo(addr);
-		if(p > 0x7 && p < 0xe) screen_palette();
+		system_deo(u, addr);
+		if(p > 0x7 && p < 0xe) screen_palette(u);
 		break;
-	case 0x10: console_deo(addr); break;
-	case 0x20: screen_deo(addr); break;
-	case 0x30: audio_deo(0, &uxn.dev[d], p); break;
-	case 0x40: audio_deo(1, &uxn.dev[d], p); break;
-	case 0x50: audio_deo(2, &uxn.dev[d], p); break;
-	case 0x60: audio_deo(3, &uxn.dev[d], p); break;
-	case 0x80: controller_deo(addr); break;
-	case 0x90: mouse_deo(addr); break;
-	case 0xa0: file_deo(addr); break;
-	case 0xb0: file_deo(addr); break;
+	case 0x10: console_deo(u, addr); break;
+	case 0x20: screen_deo(u, addr); break;
+	case 0x30: audio_deo(u, 0, &u->dev[d], p); break;
+	case 0x40: audio_deo(u, 1, &u->dev[d], p); break;
+	case 0x50: audio_deo(u, 2, &u->dev[d], p); break;
+	case 0x60: audio_deo(u, 3, &u->dev[d], p); break;
+	case 0x80: controller_deo(u, addr); break;
+	case 0x90: mouse_deo(u, addr); break;
+	case 0xa0: file_deo(u, addr); break;
+	case 0xb0: file_deo(u, addr); break;
 	}
 }
 
@@ -213,11 +248,9 @@ emu_resize(int width, int height)
 	if(emu_texture != NULL)
 		SDL_DestroyTexture(emu_texture);
 	SDL_RenderSetLogicalSize(emu_renderer, width, height);
-	emu_texture = SDL_CreateTexture(emu_renderer, SDL_PIXELFORMAT_ARGB4444, SDL_TEXTUREACCESS_STATIC, width, height);
-	if(emu_texture == NULL || SDL_SetTextureBlendMode(emu_texture, SDL_BLENDMODE_BLEND))
+	emu_texture = SDL_CreateTexture(emu_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+	if(emu_texture == NULL || SDL_SetTextureBlendMode(emu_texture, SDL_BLENDMODE_NONE))
 		return system_error("SDL_SetTextureBlendMode", SDL_GetError());
-	if(SDL_UpdateTexture(emu_texture, NULL, uxn_screen.bg,uxn_screen.width * sizeof(Uint16)) != 0)
-		return system_error("SDL_UpdateTexture", SDL_GetError());
 	emu_viewport.x = 0;
 	emu_viewport.y = 0;
 	emu_viewport.w = uxn_screen.width;
@@ -226,17 +259,137 @@ emu_resize(int width, int height)
 	return 1;
 }
 
+/* Each phase of a frame is timed, the events handled since the last frame
+counting towards it. The last frames are kept for the percentiles printed
+with F8, every frame goes to the csv file given with -t. */
+
+static Uint64
+timer_add(int phase, Uint64 since)
+{
+	Uint64 now = SDL_GetPerformanceCounter();
+	timed[phase] += now - since;
+	return now;
+}
+
+static void
+timer_frame(void)
+{
+	int i;
+	Uint32 *t = timed_us[timed_count++ % TIMED_FRAMES];
+	Uint64 freq = SDL_GetPerformanceFrequency();
+	for(i = 0, t[T_TOTAL] = 0; i < T_TOTAL; i++) {
+		t[i] = timed[i] * 1000000 / freq, timed[i] = 0;
+		t[T_TOTAL] += t[i];
+	}
+	if(timed_csv)
+		fprintf(timed_csv, "%lu,%lu,%lu,%lu,%lu,%lu\n", (unsigned long)frame, (unsigned long)t[0], (unsigned long)t[1], (unsigned long)t[2], (unsigned long)t[3], (unsigned long)t[4]);
+}
+
+static int
+by_us(const void *a, const void *b)
+{
+	Uint32 x = *(Uint32 *)a, y = *(Uint32 *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void
+timer_print(void)
+{
+	int i, j, n = timed_count < TIMED_FRAMES ? timed_count : TIMED_FRAMES;
+	static Uint32 sorted[TIMED_FRAMES];
+	if(!n) return;
+	fprintf(stderr, "Last %d frames, in microseconds:\n", n);
+	for(i = 0; i <= T_TOTAL; i++) {
+		for(j = 0; j < n; j++)
+			sorted[j] = timed_us[j][i];
+		qsort(sorted, n, sizeof(Uint32), by_us);
+		fprintf(stderr, "%-8s p50 %6lu  p95 %6lu  p99 %6lu\n", timed_names[i],
+			(unsigned long)sorted[n * 50 / 100], (unsigned long)sorted[n * 95 / 100], (unsigned long)sorted[n * 99 / 100]);
+	}
+}
+
+/* Only the tiles drawn to since the last redraw are uploaded, a run of
+them along a row of tiles making one rectangle. The layers are composited
+into the streaming texture as they are copied, the foreground where its
+colour index is not 0, through the colours of each pixel's palette slot,
+or once widened where WIDE_FG is set, from the colour each pixel holds. */
+
+static void
+emu_upload(SDL_Rect *r)
+{
+	int x, y, pitch, stride = uxn_screen.width + 16, offset = (r->y + 8) * stride + r->x + 8;
+	Uint8 *fg = uxn_screen.fg + offset, *bg = uxn_screen.bg + offset;
+	Uint16 *fg16 = uxn_screen.fg16, *bg16 = uxn_screen.bg16;
+	Uint32 *dst;
+	void *pixels;
+	if(SDL_LockTexture(emu_texture, r, &pixels, &pitch) != 0) {
+		system_error("SDL_LockTexture", SDL_GetError());
+		return;
+	}
+	for(y = 0; y < r->h; y++, fg += stride, bg += stride, offset += stride) {
+		dst = (Uint32 *)((Uint8 *)pixels + y * pitch);
+		if(uxn_screen.wide)
+			for(x = 0; x < r->w; x++)
+				dst[x] = WIDE_ARGB(fg16[offset + x] & WIDE_FG ? fg16[offset + x] : bg16[offset + x]);
+		else
+			for(x = 0; x < r->w; x++)
+				dst[x] = uxn_screen.colors[fg[x] & 3 ? fg[x] : bg[x]];
+	}
+	SDL_UnlockTexture(emu_texture);
+}
+
 static void
 emu_redraw(void)
 {
-	if(SDL_UpdateTexture(emu_texture, NULL, uxn_screen.bg+8+(uxn_screen.width+16)*8, (uxn_screen.width+16) * sizeof(Uint16)) != 0)
-		system_error("SDL_UpdateTexture", SDL_GetError());
+	int tx, ty, end;
+	Uint8 *tiles = uxn_screen.tiles;
+	SDL_Rect r;
+	Uint64 t = SDL_GetPerformanceCounter();
+	if(!tiles) {
+		r.x = r.y = 0, r.w = uxn_screen.width, r.h = uxn_screen.height;
+		emu_upload(&r);
+	} else
+		for(ty = 0; ty < uxn_screen.tiles_h; ty++, tiles += uxn_screen.tiles_w)
+			for(tx = 0; tx < uxn_screen.tiles_w; tx = end + 1) {
+				for(end = tx; end < uxn_screen.tiles_w && tiles[end]; end++)
+					tiles[end] = 0;
+				if(end == tx) continue;
+				r.x = tx << TILE_SHIFT, r.y = ty << TILE_SHIFT;
+				r.w = (end << TILE_SHIFT < uxn_screen.width ? end << TILE_SHIFT : uxn_screen.width) - r.x;
+				r.h = ((ty + 1) << TILE_SHIFT < uxn_screen.height ? (ty + 1) << TILE_SHIFT : uxn_screen.height) - r.y;
+				emu_upload(&r);
+			}
+	t = timer_add(T_UPLOAD, t);
 	SDL_RenderClear(emu_renderer);
 	SDL_RenderCopy(emu_renderer, emu_texture, NULL, &emu_viewport);
-	if(SDL_UpdateTexture(emu_texture, NULL, uxn_screen.fg+8+(uxn_screen.width+16)*8, (uxn_screen.width+16) * sizeof(Uint16)) != 0)
-		system_error("SDL_UpdateTexture", SDL_GetError());
-	SDL_RenderCopy(emu_renderer, emu_texture, NULL, &emu_viewport);
 	SDL_RenderPresent(emu_renderer);
+	timer_add(T_PRESENT, t);
+}
+
+/* While fast-forwarding or skipping frames, the title shows how many
+screen vectors ran and how many frames were drawn in the last second. */
+
+static void
+emu_rate(Uint64 now)
+{
+	char title[64];
+	Uint64 freq = SDL_GetPerformanceFrequency();
+	if(now - rate_time < freq) return;
+	if(fast_forward || frame_skip) {
+		sprintf(title, "Varvara %lu/s, %lu drawn",
+			(unsigned long)((frame - rate_frame) * freq / (now - rate_time)),
+			(unsigned long)((drawn - rate_drawn) * freq / (now - rate_time)));
+		SDL_SetWindowTitle(emu_window, title);
+	}
+	rate_time = now, rate_frame = frame, rate_drawn = drawn;
+}
+
+static void
+set_pacing(int ff, int skip)
+{
+	if((fast_forward || frame_skip) && !ff && !skip)
+		SDL_SetWindowTitle(emu_window, "Varvara");
+	fast_forward = ff, frame_skip = skip;
 }
 
 static void
@@ -282,10 +435,62 @@ static void
 emu_restart(int soft)
 {
 	screen_resize(WIDTH, HEIGHT, uxn_screen.scale);
-	system_reboot(soft);
+	file_release(&uxn);
+	held_len = held_next = 0;
+	system_reboot(&uxn, &boot, soft);
 	SDL_SetWindowTitle(emu_window, "Varvara");
 }
 
+/* With -r, every input given to the machine is logged along with the
+frame it arrived on, as ten bytes: the frame, the kind of input, a byte and
+two shorts. With -p, live input is ignored and the log is fed back on the
+same frames, without waiting for the next refresh. */
+
+static void
+input_apply(int type, Uint8 a, Uint16 x, Uint16 y)
+{
+	switch(type) {
+	case IN_MOTION: mouse_pos(&uxn, x, y); break;
+	case IN_MOUSE_UP: mouse_up(&uxn, a); break;
+	case IN_MOUSE_DOWN: mouse_down(&uxn, a); break;
+	case IN_SCROLL: mouse_scroll(&uxn, x, y); break;
+	case IN_KEY: controller_key(&uxn, a); break;
+	case IN_DOWN: controller_down(&uxn, a); break;
+	case IN_UP: controller_up(&uxn, a); break;
+	case IN_CONSOLE: console_input(&uxn, a, x); break;
+	case IN_AUDIO: uxn_eval(&uxn, PEEK2(&uxn.dev[0x30 + 0x10 * a])); break;
+	case IN_HALT: uxn.dev[0x0f] = 0xff; break;
+	case IN_RESTART: emu_restart(a); break;
+	}
+}
+
+static void
+emu_input(int type, Uint8 a, Uint16 x, Uint16 y)
+{
+	Uint8 b[10];
+	if(in_replay) return;
+	if(in_record) {
+		b[0] = frame >> 24, b[1] = frame >> 16, b[2] = frame >> 8, b[3] = frame;
+		b[4] = type, b[5] = a, b[6] = x >> 8, b[7] = x, b[8] = y >> 8, b[9] = y;
+		fwrite(b, sizeof(b), 1, in_record);
+	}
+	input_apply(type, a, x, y);
+}
+
+/* Feeds the inputs logged for this frame, returns 0 once the log ends. */
+
+static int
+input_replay(void)
+{
+	while(in_pending || fread(in_next, sizeof(in_next), 1, in_replay) == 1) {
+		Uint32 f = (Uint32)in_next[0] << 24 | in_next[1] << 16 | in_next[2] << 8 | in_next[3];
+		if((in_pending = f > frame)) return 1;
+		if(in_next[4] == IN_END) return 0;
+		input_apply(in_next[4], in_next[5], PEEK2(in_next + 6), PEEK2(in_next + 8));
+	}
+	return 0;
+}
+
 static SDL_KeyCode keymap[8] = {
 	SDLK_LCTRL,
 	SDLK_LALT,
@@ -343,11 +548,43 @@ get_key(SDL_Event *event)
 	return 0x00;
 }
 
+/* Vectors do not run while one is suspended, so events bound for the rom
+are held until it ends and then handled first, in the order they came.
+Closing the window and the function keys are handled at once. */
+
+static int
+hold_event(SDL_Event *event)
+{
+	if(event->type == SDL_QUIT || event->type == SDL_WINDOWEVENT)
+		return 0;
+	if(event->type == SDL_KEYDOWN && event->key.keysym.sym >= SDLK_F1 && event->key.keysym.sym <= SDLK_F12)
+		return 0;
+	if(event->type == SDL_MOUSEMOTION && held_len && held[held_len - 1].type == SDL_MOUSEMOTION)
+		held[held_len - 1] = *event;
+	else if(held_len < HELD_MAX)
+		held[held_len++] = *event;
+	return 1;
+}
+
+static int
+poll_event(SDL_Event *event)
+{
+	for(;;) {
+		if(!uxn.suspended && held_next < held_len) {
+			*event = held[held_next++];
+			return 1;
+		}
+		if(held_next == held_len) held_len = held_next = 0;
+		if(!SDL_PollEvent(event)) return 0;
+		if(!uxn.suspended || !hold_event(event)) return 1;
+	}
+}
+
 static int
 handle_events(void)
 {
 	SDL_Event event;
-	while(SDL_PollEvent(&event)) {
+	while(poll_event(&event)) {
 		/* Window */
 		if(event.type == SDL_QUIT)
 			return 0;
@@ -355,39 +592,43 @@ handle_events(void)
 			emu_redraw();
 		/* Mouse */
 		else if(event.type == SDL_MOUSEMOTION)
-			mouse_pos(event.motion.x, event.motion.y);
+			emu_input(IN_MOTION, 0, event.motion.x, event.motion.y);
 		else if(event.type == SDL_MOUSEBUTTONUP)
-			mouse_up(SDL_BUTTON(event.button.button));
+			emu_input(IN_MOUSE_UP, SDL_BUTTON(event.button.button), 0, 0);
 		else if(event.type == SDL_MOUSEBUTTONDOWN)
-			mouse_down(SDL_BUTTON(event.button.button));
+			emu_input(IN_MOUSE_DOWN, SDL_BUTTON(event.button.button), 0, 0);
 		else if(event.type == SDL_MOUSEWHEEL)
-			mouse_scroll(event.wheel.x, event.wheel.y);
+			emu_input(IN_SCROLL, 0, event.wheel.x, event.wheel.y);
 		/* Audio */
-		else if(event.type >= audio0_event && event.type < audio0_event + POLYPHONY) {
-			Uint8 *port_value = &uxn.dev[0x30 + 0x10 * (event.type - audio0_event)];
-			uxn_eval(port_value[0] << 8 | port_value[1]);
-		}
+		else if(event.type >= audio0_event && event.type < audio0_event + POLYPHONY)
+			emu_input(IN_AUDIO, event.type - audio0_event, 0, 0);
 		/* Controller */
 		else if(event.type == SDL_TEXTINPUT) {
 			char *c;
 			for(c = event.text.text; *c; c++)
-				controller_key(*c);
+				emu_input(IN_KEY, *c, 0, 0);
 		} else if(event.type == SDL_KEYDOWN) {
 			int ksym;
 			if(get_key(&event))
-				controller_key(get_key(&event));
+				emu_input(IN_KEY, get_key(&event), 0, 0);
 			else if(get_button(&event))
-				controller_down(get_button(&event));
+				emu_input(IN_DOWN, get_button(&event), 0, 0);
 			else if(event.key.keysym.sym == SDLK_F1)
 				set_zoom(zoom == 3 ? 1 : zoom + 1, 1);
 			else if(event.key.keysym.sym == SDLK_F2)
-				emu_deo(0xe, 0x1);
+				emu_deo(&uxn, 0xe, 0x1);
 			else if(event.key.keysym.sym == SDLK_F3)
-				uxn.dev[0x0f] = 0xff;
+				emu_input(IN_HALT, 0, 0, 0);
 			else if(event.key.keysym.sym == SDLK_F4)
-				emu_restart(0);
+				emu_input(IN_RESTART, 0, 0, 0);
 			else if(event.key.keysym.sym == SDLK_F5)
-				emu_restart(1);
+				emu_input(IN_RESTART, 1, 0, 0);
+			else if(event.key.keysym.sym == SDLK_F6)
+				set_pacing(fast_forward ? 0 : fast_every, frame_skip);
+			else if(event.key.keysym.sym == SDLK_F7)
+				set_pacing(fast_forward, !frame_skip);
+			else if(event.key.keysym.sym == SDLK_F8)
+				timer_print();
 			else if(event.key.keysym.sym == SDLK_F11)
 				set_fullscreen(!fullscreen, 1);
 			else if(event.key.keysym.sym == SDLK_F12)
@@ -396,34 +637,34 @@ handle_events(void)
 			if(SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_KEYUP, SDL_KEYUP) == 1 && ksym == event.key.keysym.sym)
 				return 1;
 		} else if(event.type == SDL_KEYUP)
-			controller_up(get_button(&event));
+			emu_input(IN_UP, get_button(&event), 0, 0);
 		else if(event.type == SDL_JOYAXISMOTION) {
 			Uint8 vec = get_vector_joystick(&event);
 			if(!vec)
-				controller_up((3 << (!event.jaxis.axis * 2)) << 4);
+				emu_input(IN_UP, (3 << (!event.jaxis.axis * 2)) << 4, 0, 0);
 			else
-				controller_down((1 << ((vec + !event.jaxis.axis * 2) - 1)) << 4);
+				emu_input(IN_DOWN, (1 << ((vec + !event.jaxis.axis * 2) - 1)) << 4, 0, 0);
 		} else if(event.type == SDL_JOYBUTTONDOWN)
-			controller_down(get_button_joystick(&event));
+			emu_input(IN_DOWN, get_button_joystick(&event), 0, 0);
 		else if(event.type == SDL_JOYBUTTONUP)
-			controller_up(get_button_joystick(&event));
+			emu_input(IN_UP, get_button_joystick(&event), 0, 0);
 		else if(event.type == SDL_JOYHATMOTION) {
 			/* NOTE: Assuming there is only one joyhat in the controller */
 			switch(event.jhat.value) {
-			case SDL_HAT_UP: controller_down(0x10); break;
-			case SDL_HAT_DOWN: controller_down(0x20); break;
-			case SDL_HAT_LEFT: controller_down(0x40); break;
-			case SDL_HAT_RIGHT: controller_down(0x80); break;
-			case SDL_HAT_LEFTDOWN: controller_down(0x40 | 0x20); break;
-			case SDL_HAT_LEFTUP: controller_down(0x40 | 0x10); break;
-			case SDL_HAT_RIGHTDOWN: controller_down(0x80 | 0x20); break;
-			case SDL_HAT_RIGHTUP: controller_down(0x80 | 0x10); break;
-			case SDL_HAT_CENTERED: controller_up(0x10 | 0x20 | 0x40 | 0x80); break;
+			case SDL_HAT_UP: emu_input(IN_DOWN, 0x10, 0, 0); break;
+			case SDL_HAT_DOWN: emu_input(IN_DOWN, 0x20, 0, 0); break;
+			case SDL_HAT_LEFT: emu_input(IN_DOWN, 0x40, 0, 0); break;
+			case SDL_HAT_RIGHT: emu_input(IN_DOWN, 0x80, 0, 0); break;
+			case SDL_HAT_LEFTDOWN: emu_input(IN_DOWN, 0x40 | 0x20, 0, 0); break;
+			case SDL_HAT_LEFTUP: emu_input(IN_DOWN, 0x40 | 0x10, 0, 0); break;
+			case SDL_HAT_RIGHTDOWN: emu_input(IN_DOWN, 0x80 | 0x20, 0, 0); break;
+			case SDL_HAT_RIGHTUP: emu_input(IN_DOWN, 0x80 | 0x10, 0, 0); break;
+			case SDL_HAT_CENTERED: emu_input(IN_UP, 0x10 | 0x20 | 0x40 | 0x80, 0, 0); break;
 			}
 		}
 		/* Console */
 		else if(event.type == stdin_event)
-			console_input(event.cbutton.button, event.cbutton.state);
+			emu_input(IN_CONSOLE, event.cbutton.button, event.cbutton.state, 0);
 	}
 	return 1;
 }
@@ -431,6 +672,7 @@ handle_events(void)
 static int
 emu_run(char *rom_path)
 {
+	int skipped = 0;
 	Uint64 next_refresh = 0;
 	Uint64 frame_interval = SDL_GetPerformanceFrequency() / 60;
 	Uint32 window_flags = SDL_WINDOW_SHOWN | SDL_WINDOW_ALLOW_HIGHDPI;
@@ -458,14 +700,34 @@ emu_run(char *rom_path)
 		exec_deadline = now + deadline_interval;
 		if(!handle_events())
 			return 0;
-		if(now >= next_refresh) {
-			now = SDL_GetPerformanceCounter();
-			next_refresh = now + frame_interval;
-			uxn_eval(uxn_screen.vector);
-			emu_redraw();
+		timer_add(T_EVENTS, now);
+		if(in_replay || fast_forward || now >= next_refresh) {
+			Uint64 t = now = SDL_GetPerformanceCounter();
+			/* when skipping, vectors keep to the 60Hz schedule unless too far behind */
+			if(frame_skip && !fast_forward && now < next_refresh + frame_interval * SKIP_MAX)
+				next_refresh += frame_interval;
+			else
+				next_refresh = now + frame_interval;
+			if(in_replay && !input_replay())
+				return 1;
+			if(uxn.suspended)
+				system_resume(&uxn);
+			else
+				uxn_eval(&uxn, uxn_screen.vector);
+			timer_add(T_VECTOR, t);
+			/* a frame is drawn unless fast-forwarding past it, or late when skipping */
+			if(fast_forward ? !(frame % fast_forward) : !frame_skip || skipped == SKIP_MAX || SDL_GetPerformanceCounter() < next_refresh)
+				emu_redraw(), drawn++, skipped = 0;
+			else
+				skipped++;
+			emu_rate(now);
+			timer_frame();
+			frame++;
 		}
-		if(uxn_screen.vector) {
-			Uint64 delay_ms = (next_refresh - now) / ms_interval;
+		if(in_replay || (fast_forward && (uxn_screen.vector || uxn.suspended)))
+			continue;
+		if(uxn_screen.vector || uxn.suspended) {
+			Uint64 delay_ms = next_refresh > now ? (next_refresh - now) / ms_interval : 0;
 			if(delay_ms > 0) SDL_Delay(delay_ms);
 		} else
 			SDL_WaitEvent(NULL);
@@ -477,6 +739,7 @@ main(int argc, char **argv)
 {
 	int i = 1;
 	char *rom_path;
+	Uint64 start;
 	/* flags */
 	while(argc > i && argv[i][0] == '-') {
 		if(!strcmp(argv[i], "-v"))
@@ -487,6 +750,30 @@ main(int argc, char **argv)
 			set_zoom(3, 0);
 		else if(strcmp(argv[i], "-f") == 0)
 			set_fullscreen(1, 0);
+		else if(!strcmp(argv[i], "-m") && i + 1 < argc) {
+			if(!system_banks(argv[++i]))
+				return system_error("Banks out of range", argv[i]);
+		} else if(!strcmp(argv[i], "-b") && i + 1 < argc)
+			uxn.budget = uxn.budget_max = strtoul(argv[++i], NULL, 0);
+		else if(!strcmp(argv[i], "-r") && i + 1 < argc) {
+			if(!(in_record = fopen(argv[++i], "wb")))
+				return system_error("Could not record", argv[i]);
+		} else if(!strcmp(argv[i], "-p") && i + 1 < argc) {
+			if(!(in_replay = fopen(argv[++i], "rb")))
+				return system_error("Could not replay", argv[i]);
+		} else if(!strcmp(argv[i], "-t") && i + 1 < argc) {
+			if(!(timed_csv = fopen(argv[++i], "w")))
+				return system_error("Could not write", argv[i]);
+			fprintf(timed_csv, "frame,events,vector,upload,present,total\n");
+		} else if(!strcmp(argv[i], "-ff") && i + 1 < argc) {
+			if((fast_every = atoi(argv[++i])) < 1) fast_every = 1;
+			fast_forward = fast_every;
+		} else if(!strcmp(argv[i], "-skip"))
+			frame_skip = 1;
+		else if(!strcmp(argv[i], "-x") && i + 1 < argc) {
+			if(!uxn_select(argv[++i]))
+				return system_error("Unknown core", argv[i]);
+		}
     else if(strcmp(argv[i], "-c") == 0){
       if(argc < i + 9){
         return system_error("poor usage of controller flag","TODO more info");
@@ -504,12 +791,23 @@ main(int argc, char **argv)
 	rom_path = i == argc ? "boot.rom" : argv[i++];
 	if(!emu_init())
 		return system_error("Init", "Failed to initialize varvara.");
-	if(!system_boot((Uint8 *)calloc(PAGE_SIZE * RAM_PAGES + 1, sizeof(Uint8)), rom_path, argc > i))
-		return system_error("usage:", "uxnemu [-v | -f | -2x | -3x] file.rom [args...]");
+	if(!system_init(&uxn, system_ram(), rom_path, argc > i))
+		return system_error("usage:", "uxnemu [-v | -f | -2x | -3x | -m banks | -b budget | -ff n | -skip | -r log | -p log | -t file.csv] file.rom [args...]");
+	if(!system_snapshot(&uxn, &boot))
+		return 0;
+	uxn_eval(&uxn, PAGE_PROGRAM);
 	/* start */
-	console_arguments(i, argc, argv);
+	console_arguments(&uxn, i, argc, argv);
+	start = SDL_GetPerformanceCounter();
 	emu_run(rom_path);
 	/* end */
+	if(in_record)
+		emu_input(IN_END, 0, 0, 0), fclose(in_record);
+	if(timed_csv)
+		fclose(timed_csv);
+	if(in_replay)
+		fprintf(stderr, "Replayed %u frames in %.3f seconds.\n", (unsigned int)frame, (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency()), fclose(in_replay);
+	uxn_profile(&uxn);
 	SDL_CloseAudioDevice(audio_id);
 #ifdef _WIN32
 #pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
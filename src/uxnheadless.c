@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "uxn.h"
+#include "devices/system.h"
+#include "devices/console.h"
+#include "devices/screen.h"
+#include "devices/audio.h"
+#include "devices/file.h"
+#include "devices/controller.h"
+#include "devices/mouse.h"
+#include "devices/datetime.h"
+
+/*
+Copyright (c) 2021-2025 Devine Lu Linvega, Andrew Alderwick
+
+Permission to use, copy, modify, and distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE.
+*/
+
+/* Runs a rom with the screen and audio devices but no display, the screen
+vector on a clock of 60 frames per second that does not wait, and writes the
+frames and the mixed audio to files or pipes. Frames are binary PPM, or raw
+RGB with -raw, one after the other, or one file each when the path holds a
+%u for the frame number. With -y, frames are also written as a YUV 4:2:0
+Y4M stream. Audio is 16-bit stereo WAV at 44100Hz, 735 samples a frame. A
+log recorded with uxnemu -r plays as the input. */
+
+#define WIDTH 64 * 8
+#define HEIGHT 40 * 8
+#define FRAME_SAMPLES (SAMPLE_FREQUENCY / 60)
+
+enum { IN_MOTION, IN_MOUSE_UP, IN_MOUSE_DOWN, IN_SCROLL, IN_KEY, IN_DOWN, IN_UP, IN_CONSOLE, IN_AUDIO, IN_HALT, IN_RESTART, IN_END };
+
+static Uxn uxn;
+static UxnSnapshot boot;
+static Uint32 frame, frames, every = 1, wav_bytes;
+static int raw, finished, frames_head, frames_width;
+static char *frames_path, *frames_tail;
+static FILE *frames_out, *wav_out, *y4m_out, *in_replay;
+static Uint8 *rgb, *indices, lut_y[0x1000], lut_u[0x1000], lut_v[0x1000];
+static int y4m_width, y4m_height;
+
+static Uint8
+audio_dei(int instance, Uint8 *d, Uint8 port)
+{
+	switch(port) {
+	case 0x4: return audio_get_vu(instance);
+	case 0x2: POKE2(d + 0x2, audio_get_position(instance)); /* fall through */
+	default: return d[port];
+	}
+}
+
+static void
+audio_deo(Uxn *u, int instance, Uint8 *d, Uint8 port)
+{
+	if(port == 0xf) audio_start(instance, d, u->ram);
+}
+
+Uint8
+emu_dei(Uxn *u, Uint8 addr)
+{
+	Uint8 p = addr & 0x0f, d = addr & 0xf0;
+	switch(d) {
+	case 0x00: return system_dei(u, addr);
+	case 0x20: return screen_dei(u, addr);
+	case 0x30: return audio_dei(0, &u->dev[d], p);
+	case 0x40: return audio_dei(1, &u->dev[d], p);
+	case 0x50: return audio_dei(2, &u->dev[d], p);
+	case 0x60: return audio_dei(3, &u->dev[d], p);
+	case 0xc0: return datetime_dei(u, addr);
+	}
+	return u->dev[addr];
+}
+
+void
+emu_deo(Uxn *u, Uint8 addr, Uint8 value)
+{
+	Uint8 p = addr & 0x0f, d = addr & 0xf0;
+	u->dev[addr] = value;
+	switch(d) {
+	case 0x00:
+		system_deo(u, addr);
+		if(p > 0x7 && p < 0xe) screen_palette(u);
+		break;
+	case 0x10: console_deo(u, addr); break;
+	case 0x20: screen_deo(u, addr); break;
+	case 0x30: audio_deo(u, 0, &u->dev[d], p); break;
+	case 0x40: audio_deo(u, 1, &u->dev[d], p); break;
+	case 0x50: audio_deo(u, 2, &u->dev[d], p); break;
+	case 0x60: audio_deo(u, 3, &u->dev[d], p); break;
+	case 0x80: controller_deo(u, addr); break;
+	case 0x90: mouse_deo(u, addr); break;
+	case 0xa0: file_deo(u, addr); break;
+	case 0xb0: file_deo(u, addr); break;
+	}
+}
+
+/* Audio vectors run once the frame's samples are mixed, as uxnemu runs
+them on the event sent from its audio thread. */
+
+void
+audio_finished_handler(int instance)
+{
+	finished |= 1 << instance;
+}
+
+int
+emu_resize(int width, int height)
+{
+	Uint8 *pixels = realloc(rgb, width * height * 3);
+	if(!pixels)
+		return system_error("Resize", "Could not allocate the frame.");
+	rgb = pixels;
+	if(!(pixels = realloc(indices, width * height * sizeof(Uint16))))
+		return system_error("Resize", "Could not allocate the frame.");
+	indices = pixels;
+	return 1;
+}
+
+static void
+wav_header(FILE *f, Uint32 bytes)
+{
+	Uint8 h[44] = "RIFF....WAVEfmt \x10\0\0\0\x01\0\x02\0....\0\0\0\0\x04\0\x10\0data....";
+	Uint32 rate = SAMPLE_FREQUENCY, byterate = SAMPLE_FREQUENCY * 4, riff = bytes + 36;
+	int i;
+	for(i = 0; i < 4; i++) {
+		h[4 + i] = riff >> (i * 8);
+		h[24 + i] = rate >> (i * 8);
+		h[28 + i] = byterate >> (i * 8);
+		h[40 + i] = bytes >> (i * 8);
+	}
+	fwrite(h, sizeof(h), 1, f);
+}
+
+static int
+audio_frame(void)
+{
+	int i, running = 0;
+	Sint16 samples[FRAME_SAMPLES * 2];
+	Uint8 out[FRAME_SAMPLES * 4];
+	memset(samples, 0, sizeof(samples));
+	for(i = 0; i < POLYPHONY; i++)
+		running += audio_render(i, samples, samples + FRAME_SAMPLES * 2);
+	if(wav_out) {
+		for(i = 0; i < FRAME_SAMPLES * 2; i++)
+			out[i * 2] = samples[i], out[i * 2 + 1] = samples[i] >> 8;
+		fwrite(out, sizeof(out), 1, wav_out);
+		wav_bytes += sizeof(out);
+	}
+	/* audio vectors wait for a suspended vector to end */
+	for(i = 0; i < POLYPHONY && !uxn.suspended; i++)
+		if(finished & 1 << i)
+			finished &= ~(1 << i), uxn_eval(&uxn, PEEK2(&uxn.dev[0x30 + 0x10 * i]));
+	return running;
+}
+
+/* The layers are composited as uxnemu does, the foreground where its
+colour index is not 0, but into a frame of indices, sixteen at a time.
+Widened layers give a frame of 16-bit indices instead, each the 12-bit
+colour of its pixel. */
+
+static void
+frame_composite(void)
+{
+	int x, y, w = uxn_screen.width, stride = w + 16;
+	Uint8 *fg, *bg, *dst;
+#ifdef __SSE2__
+	__m128i three = _mm_set1_epi8(3), zero = _mm_setzero_si128(), f, b, m;
+#endif
+	if(uxn_screen.wide) {
+		Uint16 *fg16, *bg16, *dst16 = (Uint16 *)indices;
+		for(y = 0; y < uxn_screen.height; y++, dst16 += w) {
+			fg16 = uxn_screen.fg16 + (y + 8) * stride + 8, bg16 = uxn_screen.bg16 + (y + 8) * stride + 8;
+			for(x = 0; x < w; x++)
+				dst16[x] = fg16[x] & WIDE_FG ? fg16[x] & 0xfff : bg16[x];
+		}
+		return;
+	}
+	for(y = 0; y < uxn_screen.height; y++) {
+		fg = uxn_screen.fg + (y + 8) * stride + 8, bg = uxn_screen.bg + (y + 8) * stride + 8;
+		dst = indices + y * w, x = 0;
+#ifdef __SSE2__
+		for(; x + 16 <= w; x += 16) {
+			f = _mm_loadu_si128((__m128i *)(fg + x)), b = _mm_loadu_si128((__m128i *)(bg + x));
+			m = _mm_cmpeq_epi8(_mm_and_si128(f, three), zero);
+			_mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_and_si128(m, b), _mm_andnot_si128(m, f)));
+		}
+#endif
+		for(; x < w; x++)
+			dst[x] = fg[x] & 3 ? fg[x] : bg[x];
+	}
+}
+
+/* A path with a file per frame holds one %u or %0Nu for the frame number,
+it is never used as a format. */
+
+static int
+ppm_pattern(char *path)
+{
+	char *p = strchr(path, '%'), *q = p + 1;
+	frames_width = 0;
+	if(*q == '0')
+		for(q++; *q >= '0' && *q <= '9' && frames_width < 0x10; q++)
+			frames_width = frames_width * 10 + *q - '0';
+	if(*q != 'u' || frames_width > 0x10 || strchr(q, '%'))
+		return 0;
+	frames_head = p - path, frames_tail = q + 1;
+	return 1;
+}
+
+static int
+ppm_write(void)
+{
+	int i, len = uxn_screen.width * uxn_screen.height;
+	Uint8 *dst = rgb;
+	Uint16 *wide = (Uint16 *)indices;
+	Uint32 c;
+	char path[0x400];
+	FILE *f = frames_out;
+	for(i = 0; i < len; i++, dst += 3) {
+		c = uxn_screen.wide ? WIDE_ARGB(wide[i]) : uxn_screen.colors[indices[i]];
+		dst[0] = c >> 16, dst[1] = c >> 8, dst[2] = c;
+	}
+	if(!f) {
+		sprintf(path, "%.*s%0*u%s", frames_head, frames_path, frames_width, (unsigned int)frame, frames_tail);
+		if(!(f = fopen(path, "wb")))
+			return system_error("Could not write", path);
+	}
+	if(!raw)
+		fprintf(f, "P6\n%d %d\n255\n", uxn_screen.width, uxn_screen.height);
+	fwrite(rgb, len * 3, 1, f);
+	if(f != frames_out)
+		fclose(f);
+	return 1;
+}
+
+/* A frame has at most 256 colours, or 4096 once the layers are widened,
+so each is converted to BT.601 studio range YUV once per frame, and pixels
+look theirs up. Chroma is the mean of each 2x2 block, the last column or
+row repeated when a side is odd. */
+
+static void
+y4m_palette(void)
+{
+	int i;
+	Uint32 c;
+	Sint32 r, g, b;
+	for(i = 0; i < (uxn_screen.wide ? 0x1000 : SLOTS * 4); i++) {
+		c = uxn_screen.wide ? WIDE_ARGB(i) : uxn_screen.colors[i];
+		r = c >> 16 & 0xff, g = c >> 8 & 0xff, b = c & 0xff;
+		lut_y[i] = (66 * r + 129 * g + 25 * b + 0x1080) >> 8;
+		lut_u[i] = (-38 * r - 74 * g + 112 * b + 0x8080) >> 8;
+		lut_v[i] = (112 * r - 94 * g - 18 * b + 0x8080) >> 8;
+	}
+}
+
+/* clang-format off */
+
+#define Y4M_PLANES(T) { \
+	T *idx = (T *)indices, *row, *next; \
+	for(x = 0; x < w * h; x++) \
+		rgb[x] = lut_y[idx[x]]; \
+	for(y = 0; y < ch; y++) { \
+		row = idx + y * 2 * w, next = y * 2 + 1 < h ? row + w : row; \
+		for(x = 0; x < cw; x++, u++, v++) { \
+			x2 = x * 2 + 1 < w ? x * 2 + 1 : x * 2; \
+			*u = (lut_u[row[x * 2]] + lut_u[row[x2]] + lut_u[next[x * 2]] + lut_u[next[x2]] + 2) >> 2; \
+			*v = (lut_v[row[x * 2]] + lut_v[row[x2]] + lut_v[next[x * 2]] + lut_v[next[x2]] + 2) >> 2; \
+		} \
+	} \
+}
+
+/* clang-format on */
+
+static int
+y4m_write(void)
+{
+	int x, y, x2, w = uxn_screen.width, h = uxn_screen.height, cw = (w + 1) / 2, ch = (h + 1) / 2;
+	Uint8 *u = rgb + w * h, *v = u + cw * ch;
+	if(!y4m_width) {
+		y4m_width = w, y4m_height = h;
+		fprintf(y4m_out, "YUV4MPEG2 W%d H%d F60:%u Ip A1:1 C420jpeg\n", w, h, (unsigned int)every);
+	} else if(w != y4m_width || h != y4m_height)
+		return system_error("Y4M", "The screen was resized.");
+	y4m_palette();
+	if(uxn_screen.wide)
+		Y4M_PLANES(Uint16)
+	else
+		Y4M_PLANES(Uint8)
+	fputs("FRAME\n", y4m_out);
+	fwrite(rgb, w * h + cw * ch * 2, 1, y4m_out);
+	return 1;
+}
+
+static int
+frame_write(void)
+{
+	frame_composite();
+	if(frames_path && !ppm_write())
+		return 0;
+	return !y4m_out || y4m_write();
+}
+
+static void
+input_apply(int type, Uint8 a, Uint16 x, Uint16 y)
+{
+	switch(type) {
+	case IN_MOTION: mouse_pos(&uxn, x, y); break;
+	case IN_MOUSE_UP: mouse_up(&uxn, a); break;
+	case IN_MOUSE_DOWN: mouse_down(&uxn, a); break;
+	case IN_SCROLL: mouse_scroll(&uxn, x, y); break;
+	case IN_KEY: controller_key(&uxn, a); break;
+	case IN_DOWN: controller_down(&uxn, a); break;
+	case IN_UP: controller_up(&uxn, a); break;
+	case IN_CONSOLE: console_input(&uxn, a, x); break;
+	case IN_AUDIO: break;
+	case IN_HALT: uxn.dev[0x0f] = 0xff; break;
+	case IN_RESTART:
+		screen_resize(WIDTH, HEIGHT, 1);
+		file_release(&uxn);
+		system_reboot(&uxn, &boot, a);
+		break;
+	}
+}
+
+/* Feeds the inputs logged for this frame, returns 0 once the log ends.
+Audio ends are not replayed, the audio vectors run as the mixer finds them.
+While a vector is suspended the log waits, as uxnemu holds input. */
+
+static int
+input_replay(void)
+{
+	static Uint8 next[10];
+	static int pending;
+	while(pending || fread(next, sizeof(next), 1, in_replay) == 1) {
+		Uint32 f = (Uint32)next[0] << 24 | next[1] << 16 | next[2] << 8 | next[3];
+		if((pending = f > frame)) return 1;
+		if(next[4] == IN_END) return 0;
+		input_apply(next[4], next[5], PEEK2(next + 6), PEEK2(next + 8));
+	}
+	return 0;
+}
+
+/* Runs until the rom halts, the frame count or the log runs out, or
+nothing is left that could run again. */
+
+static void
+emu_run(void)
+{
+	int running;
+	for(; !frames || frame < frames; frame++) {
+		if(uxn.dev[0x0f] || (in_replay && !uxn.suspended && !input_replay()))
+			break;
+		if(uxn.suspended)
+			system_resume(&uxn);
+		else if(uxn_screen.vector)
+			uxn_eval(&uxn, uxn_screen.vector);
+		running = audio_frame();
+		if((frames_path || y4m_out) && !(frame % every) && !frame_write())
+			break;
+		if(!running && !uxn_screen.vector && !uxn.suspended && !in_replay)
+			break;
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	int i = 1;
+	/* flags */
+	while(argc > i && argv[i][0] == '-') {
+		if(!strcmp(argv[i], "-v"))
+			return !fprintf(stdout, "Uxn(headless) - Varvara Emulator, 4 Apr 2025.\n");
+		else if(!strcmp(argv[i], "-n") && i + 1 < argc)
+			frames = strtoul(argv[++i], NULL, 0);
+		else if(!strcmp(argv[i], "-e") && i + 1 < argc) {
+			if((every = strtoul(argv[++i], NULL, 0)) < 1) every = 1;
+		} else if(!strcmp(argv[i], "-o") && i + 1 < argc) {
+			if(strlen(frames_path = argv[++i]) > 0x3e0)
+				return system_error("Path too long", frames_path);
+			if(!strcmp(frames_path, "-"))
+				frames_out = stdout;
+			else if(strchr(frames_path, '%')) {
+				if(!ppm_pattern(frames_path))
+					return system_error("Path wants one %u or %0Nu", frames_path);
+			} else if(!(frames_out = fopen(frames_path, "wb")))
+				return system_error("Could not write", frames_path);
+		} else if(!strcmp(argv[i], "-y") && i + 1 < argc) {
+			if(!(y4m_out = strcmp(argv[++i], "-") ? fopen(argv[i], "wb") : stdout))
+				return system_error("Could not write", argv[i]);
+		} else if(!strcmp(argv[i], "-raw"))
+			raw = 1;
+		else if(!strcmp(argv[i], "-a") && i + 1 < argc) {
+			if(!(wav_out = strcmp(argv[++i], "-") ? fopen(argv[i], "wb") : stdout))
+				return system_error("Could not write", argv[i]);
+			wav_header(wav_out, 0xffffffdb);
+		} else if(!strcmp(argv[i], "-p") && i + 1 < argc) {
+			if(!(in_replay = fopen(argv[++i], "rb")))
+				return system_error("Could not replay", argv[i]);
+		} else if(!strcmp(argv[i], "-m") && i + 1 < argc) {
+			if(!system_banks(argv[++i]))
+				return system_error("Banks out of range", argv[i]);
+		} else if(!strcmp(argv[i], "-b") && i + 1 < argc)
+			uxn.budget = uxn.budget_max = strtoul(argv[++i], NULL, 0);
+		else if(!strcmp(argv[i], "-x") && i + 1 < argc) {
+			if(!uxn_select(argv[++i]))
+				return system_error("Unknown core", argv[i]);
+		} else
+			break;
+		i++;
+	}
+	if(i >= argc)
+		return !fprintf(stdout, "usage: %s [-v] [-n frames] [-e every] [-o frames.ppm|frame%%04u.ppm|-] [-raw] [-y video.y4m|-] [-a audio.wav|-] [-p log] [-m banks] [-b budget] [-x core] file.rom [args..]\n", argv[0]);
+	/* init */
+	screen_resize(WIDTH, HEIGHT, 1);
+	if(!system_init(&uxn, system_ram(), argv[i], argc > i + 1))
+		return !fprintf(stdout, "Could not load %s.\n", argv[i]);
+	if(!system_snapshot(&uxn, &boot))
+		return 0;
+	uxn_eval(&uxn, PAGE_PROGRAM);
+	console_arguments(&uxn, i + 1, argc, argv);
+	/* start */
+	emu_run();
+	/* end, the sizes of a wav that can be rewound are filled in */
+	if(wav_out && wav_out != stdout) {
+		if(!fseek(wav_out, 0, SEEK_SET)) wav_header(wav_out, wav_bytes);
+		fclose(wav_out);
+	}
+	if(frames_out && frames_out != stdout)
+		fclose(frames_out);
+	if(y4m_out && y4m_out != stdout)
+		fclose(y4m_out);
+	if(in_replay)
+		fclose(in_replay);
+	file_release(&uxn);
+	uxn_release(&uxn);
+	free(rgb), free(indices), free(uxn.dirty), system_ram_free(uxn.ram);
+	return uxn.dev[0x0f] & 0x7f;
+}